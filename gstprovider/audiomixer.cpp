@@ -0,0 +1,311 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+#include "audiomixer.h"
+
+#include "psimediaprovider.h"
+#include <QElapsedTimer>
+#include <QHash>
+#include <QVector>
+#include <gst/app/gstappsrc.h>
+
+// mixing is done on mono 16-bit samples at the opus rate, in 20ms frames
+#define MIXER_RATE 48000
+#define MIXER_FRAME_MS 20
+#define MIXER_FRAME_SAMPLES (MIXER_RATE * MIXER_FRAME_MS / 1000)
+#define MIXER_FRAME_BYTES (MIXER_FRAME_SAMPLES * 2)
+#define MIXER_CAPS "audio/x-raw,format=S16LE,rate=48000,channels=1,layout=interleaved"
+
+// said but not yet mixed audio beyond this is dropped, oldest first, to
+//   keep the latency down when a participant sends in bursts
+#define MIXER_QUEUE_FRAMES 5
+
+namespace PsiMedia {
+
+class AudioMixer {
+public:
+    QString                   name;
+    GstElement *              pipeline;
+    GSource *                 timer;
+    QMutex                    m;
+    QList<MixerParticipant *> participants;
+    QElapsedTimer             clock;
+    qint64                    framesDone;
+    QVector<qint32>           sum;
+
+    static AudioMixer *join(MixerParticipant *p, const QString &name, GMainContext *mainContext);
+    static void        leave(MixerParticipant *p);
+
+private:
+    AudioMixer(const QString &_name, GMainContext *mainContext);
+    ~AudioMixer();
+
+    static gboolean cb_tick(gpointer data);
+    static void     cb_timer_destroyed(gpointer data);
+
+    gboolean tick();
+    void     mixFrame();
+};
+
+// mixes by name
+static QMutex                       mixers_mutex;
+static QHash<QString, AudioMixer *> mixers;
+
+AudioMixer::AudioMixer(const QString &_name, GMainContext *mainContext) :
+    name(_name), framesDone(0), sum(MIXER_FRAME_SAMPLES)
+{
+    pipeline = gst_pipeline_new(nullptr);
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+
+    clock.start();
+
+    // the callback data is referenced while a tick is dispatched, so the
+    //   mixer is only deleted once the timer is destroyed and no tick runs
+    timer = g_timeout_source_new(MIXER_FRAME_MS / 2);
+    g_source_set_callback(timer, cb_tick, this, cb_timer_destroyed);
+    g_source_attach(timer, mainContext);
+}
+
+AudioMixer::~AudioMixer()
+{
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_element_get_state(pipeline, nullptr, nullptr, GST_CLOCK_TIME_NONE);
+    g_object_unref(G_OBJECT(pipeline));
+}
+
+AudioMixer *AudioMixer::join(MixerParticipant *p, const QString &name, GMainContext *mainContext)
+{
+    QMutexLocker locker(&mixers_mutex);
+    AudioMixer * mixer = mixers.value(name);
+    if (!mixer) {
+        mixer = new AudioMixer(name, mainContext);
+        mixers.insert(name, mixer);
+    }
+
+    QMutexLocker mixerLocker(&mixer->m);
+    mixer->participants += p;
+    return mixer;
+}
+
+void AudioMixer::leave(MixerParticipant *p)
+{
+    QMutexLocker locker(&mixers_mutex);
+    AudioMixer * mixer = p->mixer;
+
+    mixer->m.lock();
+    mixer->participants.removeAll(p);
+    bool empty = mixer->participants.isEmpty();
+    mixer->m.unlock();
+
+    if (empty) {
+        mixers.remove(mixer->name);
+        g_source_destroy(mixer->timer);
+        g_source_unref(mixer->timer);
+    }
+}
+
+gboolean AudioMixer::cb_tick(gpointer data) { return static_cast<AudioMixer *>(data)->tick(); }
+
+void AudioMixer::cb_timer_destroyed(gpointer data) { delete static_cast<AudioMixer *>(data); }
+
+gboolean AudioMixer::tick()
+{
+    QMutexLocker locker(&m);
+
+    // the timer runs at twice the frame rate and we mix however many frames
+    //   are due by the clock, so timer jitter doesn't add up to drift.  after
+    //   a stall, don't try to catch up on more than could have been queued.
+    qint64 due = clock.elapsed() / MIXER_FRAME_MS;
+    if (due - framesDone > MIXER_QUEUE_FRAMES)
+        framesDone = due - MIXER_QUEUE_FRAMES;
+
+    for (; framesDone < due; ++framesDone)
+        mixFrame();
+
+    return TRUE;
+}
+
+void AudioMixer::mixFrame()
+{
+    QVector<QByteArray> own(participants.count());
+
+    sum.fill(0);
+    for (int n = 0; n < participants.count(); ++n) {
+        MixerParticipant *p = participants[n];
+        {
+            QMutexLocker locker(&p->m);
+            if (p->pending.size() < MIXER_FRAME_BYTES)
+                continue; // nothing to say, or not enough yet
+            own[n] = p->pending.left(MIXER_FRAME_BYTES);
+            p->pending.remove(0, MIXER_FRAME_BYTES);
+        }
+
+        const qint16 *in = reinterpret_cast<const qint16 *>(own[n].constData());
+        for (int s = 0; s < MIXER_FRAME_SAMPLES; ++s)
+            sum[s] += in[s];
+    }
+
+    for (int n = 0; n < participants.count(); ++n) {
+        MixerParticipant *p = participants[n];
+        if (!p->appsrc)
+            continue;
+
+        GstBuffer * buffer = gst_buffer_new_allocate(nullptr, MIXER_FRAME_BYTES, nullptr);
+        GstMapInfo  map;
+        gst_buffer_map(buffer, &map, GST_MAP_WRITE);
+        qint16 *      out = reinterpret_cast<qint16 *>(map.data);
+        const qint16 *in  = own[n].isEmpty() ? nullptr : reinterpret_cast<const qint16 *>(own[n].constData());
+        for (int s = 0; s < MIXER_FRAME_SAMPLES; ++s) {
+            qint32 x = sum[s] - (in ? in[s] : 0);
+            out[s]   = qint16(qBound(-32768, x, 32767));
+        }
+        gst_buffer_unmap(buffer, &map);
+
+        gst_app_src_push_buffer(reinterpret_cast<GstAppSrc *>(p->appsrc), buffer);
+    }
+}
+
+//----------------------------------------------------------------------------
+// MixerParticipant
+//----------------------------------------------------------------------------
+bool MixerParticipant::isMixerDevice(const QString &deviceId)
+{
+    return deviceId.startsWith(QLatin1String(PSIMEDIA_MIXER_DEVICE_PREFIX));
+}
+
+MixerParticipant::MixerParticipant(const QString &deviceId, GMainContext *mainContext)
+{
+    QLatin1String prefix(PSIMEDIA_MIXER_DEVICE_PREFIX);
+    mixer = AudioMixer::join(this, deviceId.mid(prefix.size()), mainContext);
+}
+
+MixerParticipant::~MixerParticipant()
+{
+    removeSource();
+    AudioMixer::leave(this);
+}
+
+GstElement *MixerParticipant::addSource()
+{
+    GstElement *src  = gst_element_factory_make("appsrc", nullptr);
+    GstCaps *   caps = gst_caps_from_string(MIXER_CAPS);
+    g_object_set(G_OBJECT(src), "caps", caps, "is-live", TRUE, "do-timestamp", TRUE, "format", GST_FORMAT_TIME,
+                 "max-bytes", guint64(MIXER_QUEUE_FRAMES * MIXER_FRAME_BYTES), nullptr);
+    gst_caps_unref(caps);
+    gst_bin_add(GST_BIN(mixer->pipeline), src);
+
+    QMutexLocker locker(&mixer->m);
+    appsrc = src;
+    return src;
+}
+
+void MixerParticipant::removeSource()
+{
+    mixer->m.lock();
+    GstElement *src = appsrc;
+    appsrc          = nullptr;
+    mixer->m.unlock();
+
+    if (!src)
+        return;
+
+    gst_element_set_state(src, GST_STATE_NULL);
+    gst_element_get_state(src, nullptr, nullptr, GST_CLOCK_TIME_NONE);
+    gst_bin_remove(GST_BIN(mixer->pipeline), src);
+}
+
+void MixerParticipant::pushSilence()
+{
+    QMutexLocker locker(&mixer->m);
+    if (!appsrc)
+        return;
+
+    GstBuffer *buffer = gst_buffer_new_allocate(nullptr, MIXER_FRAME_BYTES, nullptr);
+    gst_buffer_memset(buffer, 0, 0, MIXER_FRAME_BYTES);
+    gst_app_src_push_buffer(reinterpret_cast<GstAppSrc *>(appsrc), buffer);
+}
+
+void MixerParticipant::addBin(GstElement *bin) { gst_bin_add(GST_BIN(mixer->pipeline), bin); }
+
+bool MixerParticipant::removeBin(GstElement *bin)
+{
+    if (GST_ELEMENT_PARENT(bin) != mixer->pipeline)
+        return false;
+
+    gst_element_set_state(bin, GST_STATE_NULL);
+    gst_element_get_state(bin, nullptr, nullptr, GST_CLOCK_TIME_NONE);
+    gst_bin_remove(GST_BIN(mixer->pipeline), bin);
+    return true;
+}
+
+GstElement *MixerParticipant::createSink()
+{
+    GstElement *sink = gst_element_factory_make("appsink", nullptr);
+    GstCaps *   caps = gst_caps_from_string(MIXER_CAPS);
+    g_object_set(G_OBJECT(sink), "caps", caps, "sync", FALSE, "async", FALSE, nullptr);
+    gst_caps_unref(caps);
+
+    GstAppSinkCallbacks sinkCb = {};
+    sinkCb.new_sample          = cb_new_sample;
+    sinkCb.eos                 = cb_eos;
+    sinkCb.new_preroll         = cb_new_preroll;
+    gst_app_sink_set_callbacks(reinterpret_cast<GstAppSink *>(sink), &sinkCb, this, nullptr);
+    return sink;
+}
+
+GstFlowReturn MixerParticipant::cb_new_sample(GstAppSink *appsink, gpointer data)
+{
+    return static_cast<MixerParticipant *>(data)->new_sample(appsink);
+}
+
+GstFlowReturn MixerParticipant::cb_new_preroll(GstAppSink *appsink, gpointer data)
+{
+    Q_UNUSED(appsink);
+    Q_UNUSED(data);
+    return GST_FLOW_OK;
+}
+
+void MixerParticipant::cb_eos(GstAppSink *appsink, gpointer data)
+{
+    Q_UNUSED(appsink);
+    Q_UNUSED(data);
+}
+
+GstFlowReturn MixerParticipant::new_sample(GstAppSink *appsink)
+{
+    GstSample *sample = gst_app_sink_pull_sample(appsink);
+    if (!sample)
+        return GST_FLOW_OK;
+
+    GstBuffer *buffer = gst_sample_get_buffer(sample);
+    GstMapInfo map;
+    if (buffer && gst_buffer_map(buffer, &map, GST_MAP_READ)) {
+        QMutexLocker locker(&m);
+        pending.append(reinterpret_cast<const char *>(map.data), int(map.size));
+        if (pending.size() > MIXER_QUEUE_FRAMES * MIXER_FRAME_BYTES)
+            pending.remove(0, pending.size() - MIXER_QUEUE_FRAMES * MIXER_FRAME_BYTES);
+        gst_buffer_unmap(buffer, &map);
+    }
+    gst_sample_unref(sample);
+
+    return GST_FLOW_OK;
+}
+
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+#ifndef PSI_AUDIOMIXER_H
+#define PSI_AUDIOMIXER_H
+
+#include <QByteArray>
+#include <QMutex>
+#include <QString>
+#include <gst/app/gstappsink.h>
+#include <gst/gst.h>
+
+namespace PsiMedia {
+
+class AudioMixer;
+
+// a session taking part in a conference mix, selected by using an audio
+//   device id starting with PSIMEDIA_MIXER_DEVICE_PREFIX.  every participant
+//   hears everyone else in the mix, but not itself (mix-minus).  the full mix
+//   is summed once per frame, and each participant gets it with its own
+//   contribution taken out again, so the cost grows with the number of
+//   participants rather than with its square.
+//
+// each conference has a pipeline of its own, always playing, which the
+//   sessions taking part put their bins in.  unlike the shared device
+//   pipelines, any number of sessions can send and receive in it at once.
+class MixerParticipant {
+public:
+    static bool isMixerDevice(const QString &deviceId);
+
+    // joins the mix named by deviceId, creating it if this is the first
+    //   participant.  the mix runs from a timer on mainContext.
+    MixerParticipant(const QString &deviceId, GMainContext *mainContext);
+    ~MixerParticipant();
+
+    // a live source of what this participant hears, in the conference
+    //   pipeline.  it stays until removeSource() or destruction.
+    GstElement *addSource();
+    void        removeSource();
+
+    // push a frame of silence to the source right away, rather than waiting
+    //   for the next mix
+    void pushSilence();
+
+    // a sink for what this participant says, for the caller to put in one
+    //   of its bins
+    GstElement *createSink();
+
+    // put a bin in the conference pipeline, or take it out and stop it.
+    //   removeBin() returns false if the bin isn't in there.  bins with a
+    //   sink from createSink() must be removed before the participant is
+    //   deleted.
+    void addBin(GstElement *bin);
+    bool removeBin(GstElement *bin);
+
+private:
+    friend class AudioMixer;
+
+    AudioMixer *mixer;
+    GstElement *appsrc = nullptr; // guarded by the mixer
+
+    QMutex     m;
+    QByteArray pending; // samples said, not mixed yet
+
+    static GstFlowReturn cb_new_sample(GstAppSink *appsink, gpointer data);
+    static GstFlowReturn cb_new_preroll(GstAppSink *appsink, gpointer data);
+    static void          cb_eos(GstAppSink *appsink, gpointer data);
+
+    GstFlowReturn new_sample(GstAppSink *appsink);
+};
+
+}
+
+#endif
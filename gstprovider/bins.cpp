@@ -25,11 +25,25 @@
 #include <gst/gst.h>
 #include <stdio.h>
 
+#include "psimediaprovider.h"
+
 // default latency is 200ms
 #define DEFAULT_RTP_LATENCY 200
 
+// threads for scaling/conversion, 0 = one per cpu
+#define DEFAULT_VIDEO_THREADS 0
+
 namespace PsiMedia {
 
+static int get_video_threads()
+{
+    QString val = QString::fromLatin1(qgetenv("PSI_VIDEO_THREADS"));
+    if (!val.isEmpty())
+        return qMax(val.toInt(), 0);
+    else
+        return DEFAULT_VIDEO_THREADS;
+}
+
 static int get_rtp_latency()
 {
     QString val = QString::fromLatin1(qgetenv("PSI_RTP_LATENCY"));
@@ -57,12 +71,68 @@ static GstElement *audio_codec_to_enc_element(const QString &name)
     return gst_element_factory_make(ename.toLatin1().data(), nullptr);
 }
 
+static bool has_property(GstElement *e, const char *name)
+{
+    return g_object_class_find_property(G_OBJECT_GET_CLASS(e), name) != nullptr;
+}
+
+// opus works at 48khz internally, and so does the echo canceller in
+//   pipeline.cpp.  the mode's sample rate only limits the coded bandwidth.
+#define OPUS_RATE 48000
+
+static const char *opus_bandwidth(int rate)
+{
+    if (rate <= 8000)
+        return "narrowband";
+    else if (rate <= 12000)
+        return "mediumband";
+    else if (rate <= 16000)
+        return "wideband";
+    else if (rate <= 24000)
+        return "superwideband";
+    else
+        return "fullband";
+}
+
+// opus frame sizes are fixed, anything else is left to the encoder
+static bool opus_valid_frame_size(int ms) { return ms == 10 || ms == 20 || ms == 40 || ms == 60; }
+
+static void opus_configure_encoder(GstElement *enc, GstElement *pay, const PAudioParams &params)
+{
+    if (params.sampleRate > 0)
+        gst_util_set_object_arg(G_OBJECT(enc), "bandwidth", opus_bandwidth(params.sampleRate));
+    if (opus_valid_frame_size(params.ptime))
+        gst_util_set_object_arg(G_OBJECT(enc), "frame-size", QByteArray::number(params.ptime).data());
+    if (params.bitrate > 0)
+        g_object_set(G_OBJECT(enc), "bitrate", qBound(4000, params.bitrate * 1000, 650000), NULL);
+    if (params.complexity > 0)
+        g_object_set(G_OBJECT(enc), "complexity", qMin(params.complexity, 10), NULL);
+
+    // fec data is sized for the expected loss, without a figure the
+    //   encoder assumes there is none and adds nothing
+    if (params.fec)
+        g_object_set(G_OBJECT(enc), "inband-fec", TRUE, "packet-loss-percentage",
+                     qBound(1, params.packetLoss, 100), NULL);
+
+    // during silence the encoder only emits a tiny frame every 400ms, the
+    //   payloader (if it can) doesn't even send those
+    if (params.dtx) {
+        g_object_set(G_OBJECT(enc), "dtx", TRUE, NULL);
+        if (has_property(pay, "dtx"))
+            g_object_set(G_OBJECT(pay), "dtx", TRUE, NULL);
+    }
+}
+
 static GstElement *audio_codec_to_dec_element(const QString &name)
 {
     QString ename;
-    if (name == "opus")
-        ename = "opusdec";
-    else if (name == "vorbis")
+    if (name == "opus") {
+        // use the fec data in the next packet to recover a lost one, or
+        //   conceal the gap if there is none
+        auto e = gst_element_factory_make("opusdec", nullptr);
+        g_object_set(G_OBJECT(e), "use-inband-fec", TRUE, "plc", TRUE, NULL);
+        return e;
+    } else if (name == "vorbis")
         ename = "vorbisdec";
     else if (name == "pcmu")
         ename = "mulawdec";
@@ -84,7 +154,7 @@ static GstElement *audio_codec_to_rtppay_element(const QString &name)
     else
         return nullptr;
 
-    return gst_element_factory_make(ename.toLatin1().data(), nullptr);
+    return gst_element_factory_make(ename.toLatin1().data(), "audio-payloader");
 }
 
 static GstElement *audio_codec_to_rtpdepay_element(const QString &name)
@@ -102,6 +172,7 @@ static GstElement *audio_codec_to_rtpdepay_element(const QString &name)
     return gst_element_factory_make(ename.toLatin1().data(), nullptr);
 }
 
+// named, so that the bitrate can be adjusted later
 static GstElement *video_codec_to_enc_element(const QString &name)
 {
     QString ename;
@@ -112,7 +183,7 @@ static GstElement *video_codec_to_enc_element(const QString &name)
     else
         return nullptr;
 
-    return gst_element_factory_make(ename.toLatin1().data(), nullptr);
+    return gst_element_factory_make(ename.toLatin1().data(), "video-encoder");
 }
 
 static GstElement *video_codec_to_dec_element(const QString &name)
@@ -138,7 +209,7 @@ static GstElement *video_codec_to_rtppay_element(const QString &name)
     else
         return nullptr;
 
-    return gst_element_factory_make(ename.toLatin1().data(), nullptr);
+    return gst_element_factory_make(ename.toLatin1().data(), "video-payloader");
 }
 
 static GstElement *video_codec_to_rtpdepay_element(const QString &name)
@@ -214,92 +285,129 @@ static bool video_codec_get_recv_elements(const QString &name, GstElement **dec,
     return true;
 }
 
-GstElement *bins_videoprep_create(const QSize &size, int fps, bool is_live)
+// the raw format the encoder takes without converting internally
+static const char *video_codec_native_format(const QString &name)
+{
+    Q_UNUSED(name)
+    // theora and h263p both want planar 4:2:0
+    return "I420";
+}
+
+static void set_video_threads(GstElement *e)
+{
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(e), "n-threads"))
+        g_object_set(G_OBJECT(e), "n-threads", guint(get_video_threads()), NULL);
+}
+
+// frames are dropped first, before any pixel is touched, and then scaled and
+//   converted into the encoder's format in one go
+GstElement *bins_videoprep_create(const QString &codec, const QSize &size, int fps, bool is_live)
 {
     GstElement *bin = gst_bin_new("videoprepbin");
 
     GstElement *videorate  = nullptr;
     GstElement *ratefilter = nullptr;
     if (fps != -1) {
-        videorate = gst_element_factory_make("videorate", nullptr);
+        // when live, the rate can be lowered later through the max-rate of
+        //   the "video-rate" element.  a fixed framerate filter after it
+        //   would refuse the lower rate, so instead the nominal rate is
+        //   stamped back onto the caps: frames go missing, but the encoder
+        //   never sees a format change and keeps its headers.
+        if (is_live)
+            ratefilter = gst_element_factory_make("capssetter", nullptr);
 
-        ratefilter = gst_element_factory_make("capsfilter", nullptr);
+        videorate = gst_element_factory_make("videorate", ratefilter ? "video-rate" : nullptr);
 
-        GstCaps *     caps = gst_caps_new_empty();
-        GstStructure *cs   = gst_structure_new("video/x-raw", "framerate", GST_TYPE_FRACTION, fps, 1, NULL);
+        // a live source never needs frames made up, only thrown away
+        if (is_live && g_object_class_find_property(G_OBJECT_GET_CLASS(videorate), "drop-only"))
+            g_object_set(G_OBJECT(videorate), "drop-only", TRUE, NULL);
 
-        gst_caps_append_structure(caps, cs);
-
-        g_object_set(G_OBJECT(ratefilter), "caps", caps, NULL);
-        gst_caps_unref(caps);
-    }
-
-    GstElement *videoscale  = nullptr;
-    GstElement *scalefilter = nullptr;
-    if (size.isValid()) {
-        videoscale  = gst_element_factory_make("videoscale", nullptr);
-        scalefilter = gst_element_factory_make("capsfilter", nullptr);
+        if (ratefilter)
+            g_object_set(G_OBJECT(videorate), "max-rate", fps, NULL);
+        else
+            ratefilter = gst_element_factory_make("capsfilter", nullptr);
 
         GstCaps *     caps = gst_caps_new_empty();
-        GstStructure *cs   = gst_structure_new("video/x-raw", "width", G_TYPE_INT, size.width(), "height", G_TYPE_INT,
-                                             size.height(), NULL);
+        GstStructure *cs   = gst_structure_new("video/x-raw", "framerate", GST_TYPE_FRACTION, fps, 1, NULL);
 
         gst_caps_append_structure(caps, cs);
 
-        g_object_set(G_OBJECT(scalefilter), "caps", caps, NULL);
+        g_object_set(G_OBJECT(ratefilter), "caps", caps, NULL);
         gst_caps_unref(caps);
     }
 
-    if (!videorate && !videoscale) {
-        // not altering anything?  return no-op
-        return gst_element_factory_make("identity", nullptr);
+    // videoconvertscale does both in a single pass over the frame.  older
+    //   gstreamer doesn't have it, so scale first there (the frame usually
+    //   gets smaller) and convert what's left.
+    GstElement *convertscale = gst_element_factory_make("videoconvertscale", nullptr);
+    GstElement *videoscale   = nullptr;
+    GstElement *videoconvert = nullptr;
+    if (convertscale)
+        set_video_threads(convertscale);
+    else {
+        videoscale   = gst_element_factory_make("videoscale", nullptr);
+        videoconvert = gst_element_factory_make("videoconvert", nullptr);
+        set_video_threads(videoscale);
+        set_video_threads(videoconvert);
     }
 
-    GstElement *start, *end;
-    if (videorate && videoscale) {
-        start = videorate;
-        end   = scalefilter;
-    } else if (videorate && !videoscale) {
-        start = videorate;
-        end   = ratefilter;
-    } else // !videorate && videoscale
-    {
-        start = videoscale;
-        end   = scalefilter;
-    }
+    GstElement *  outfilter = gst_element_factory_make("capsfilter", nullptr);
+    GstStructure *cs
+        = gst_structure_new("video/x-raw", "format", G_TYPE_STRING, video_codec_native_format(codec), NULL);
+    if (size.isValid())
+        gst_structure_set(cs, "width", G_TYPE_INT, size.width(), "height", G_TYPE_INT, size.height(), NULL);
+    GstCaps *caps = gst_caps_new_full(cs, NULL);
+    g_object_set(G_OBJECT(outfilter), "caps", caps, NULL);
+    gst_caps_unref(caps);
 
+    GstElement *start = nullptr;
     if (videorate) {
         gst_bin_add(GST_BIN(bin), videorate);
         gst_bin_add(GST_BIN(bin), ratefilter);
         gst_element_link(videorate, ratefilter);
+        start = videorate;
     }
 
-    if (videoscale) {
+    gst_bin_add(GST_BIN(bin), outfilter);
+    if (convertscale) {
+        gst_bin_add(GST_BIN(bin), convertscale);
+        gst_element_link(convertscale, outfilter);
+        if (videorate)
+            gst_element_link(ratefilter, convertscale);
+        else
+            start = convertscale;
+    } else {
         gst_bin_add(GST_BIN(bin), videoscale);
-        gst_bin_add(GST_BIN(bin), scalefilter);
-        gst_element_link(videoscale, scalefilter);
+        gst_bin_add(GST_BIN(bin), videoconvert);
+        gst_element_link_many(videoscale, videoconvert, outfilter, NULL);
+        if (videorate)
+            gst_element_link(ratefilter, videoscale);
+        else
+            start = videoscale;
     }
 
-    if (videorate && videoscale)
-        gst_element_link(ratefilter, videoscale);
-
     GstPad *pad;
 
     pad = gst_element_get_static_pad(start, "sink");
     gst_element_add_pad(bin, gst_ghost_pad_new("sink", pad));
     gst_object_unref(GST_OBJECT(pad));
 
-    pad = gst_element_get_static_pad(end, "src");
+    pad = gst_element_get_static_pad(outfilter, "src");
     gst_element_add_pad(bin, gst_ghost_pad_new("src", pad));
     gst_object_unref(GST_OBJECT(pad));
 
     return bin;
 }
 
-GstElement *bins_audioenc_create(const QString &codec, int id, int rate, int size, int channels)
+GstElement *bins_audioenc_create(const PAudioParams &params, int id)
 {
-    bool variableRate = (codec == QLatin1String("opus")); // opus supports variable bitrate and resampling on its own
-    GstElement *bin   = gst_bin_new("audioencbin");
+    const QString &codec    = params.codec;
+    int            rate     = params.sampleRate;
+    int            size     = params.sampleSize;
+    int            channels = params.channels;
+
+    bool        opus = (codec == QLatin1String("opus"));
+    GstElement *bin  = gst_bin_new("audioencbin");
 
     GstElement *audioenc    = nullptr;
     GstElement *audiortppay = nullptr;
@@ -309,21 +417,19 @@ GstElement *bins_audioenc_create(const QString &codec, int id, int rate, int siz
     if (id != -1)
         g_object_set(G_OBJECT(audiortppay), "pt", id, NULL);
 
+    if (opus)
+        opus_configure_encoder(audioenc, audiortppay, params);
+
+    // with opus the input is normally at OPUS_RATE already and the
+    //   resampler just passes it through
     GstElement *audioconvert  = gst_element_factory_make("audioconvert", nullptr);
-    GstElement *audioresample = nullptr;
-    if (!variableRate) {
-        // suppose variadic-rate encoder have internal resampler (like opus)
-        audioresample = gst_element_factory_make("audioresample", nullptr);
-    }
+    GstElement *audioresample = gst_element_factory_make("audioresample", nullptr);
 
     GstStructure *cs;
     GstCaps *     caps = gst_caps_new_empty();
-    if (variableRate) {
-        // there is much sense to change rate if variadic-rate codec can do internal resampling.
-        // also width could be taken from internal codec's caps. just any width.
-        cs = gst_structure_new("audio/x-raw", "channels", G_TYPE_INT, channels, "channel-mask", GST_TYPE_BITMASK, 1,
-                               NULL);
-        qDebug("channels=%d\n", channels);
+    if (opus) {
+        cs = gst_structure_new("audio/x-raw", "rate", G_TYPE_INT, OPUS_RATE, "channels", G_TYPE_INT, channels,
+                               "channel-mask", GST_TYPE_BITMASK, channels == 2 ? 3 : 1, NULL);
     } else {
         cs = gst_structure_new("audio/x-raw", "rate", G_TYPE_INT, rate, "width", G_TYPE_INT, size, "channels",
                                G_TYPE_INT, channels, "channel-mask", GST_TYPE_BITMASK, 1, NULL);
@@ -335,18 +441,12 @@ GstElement *bins_audioenc_create(const QString &codec, int id, int rate, int siz
     gst_caps_unref(caps);
 
     gst_bin_add(GST_BIN(bin), audioconvert);
-    if (audioresample) {
-        gst_bin_add(GST_BIN(bin), audioresample);
-    }
+    gst_bin_add(GST_BIN(bin), audioresample);
     gst_bin_add(GST_BIN(bin), capsfilter);
     gst_bin_add(GST_BIN(bin), audioenc);
     gst_bin_add(GST_BIN(bin), audiortppay);
 
-    if (audioresample) {
-        gst_element_link_many(audioconvert, audioresample, capsfilter, audioenc, audiortppay, NULL);
-    } else {
-        gst_element_link_many(audioconvert, capsfilter, audioenc, audiortppay, NULL);
-    }
+    gst_element_link_many(audioconvert, audioresample, capsfilter, audioenc, audiortppay, NULL);
 
     GstPad *pad;
 
@@ -376,17 +476,15 @@ GstElement *bins_videoenc_create(const QString &codec, int id, int maxkbps)
     if (codec == "theora")
         g_object_set(G_OBJECT(videoenc), "bitrate", maxkbps, NULL);
 
-    GstElement *videoconvert = gst_element_factory_make("videoconvert", nullptr);
-
-    gst_bin_add(GST_BIN(bin), videoconvert);
+    // no converter here, videoprep already delivers the native format
     gst_bin_add(GST_BIN(bin), videoenc);
     gst_bin_add(GST_BIN(bin), videortppay);
 
-    gst_element_link_many(videoconvert, videoenc, videortppay, NULL);
+    gst_element_link(videoenc, videortppay);
 
     GstPad *pad;
 
-    pad = gst_element_get_static_pad(videoconvert, "sink");
+    pad = gst_element_get_static_pad(videoenc, "sink");
     gst_element_add_pad(bin, gst_ghost_pad_new("sink", pad));
     gst_object_unref(GST_OBJECT(pad));
 
@@ -406,7 +504,7 @@ GstElement *bins_audiodec_create(const QString &codec)
     if (!audio_codec_get_recv_elements(codec, &audiodec, &audiortpdepay))
         return nullptr;
 
-    GstElement *audiortpjitterbuffer = gst_element_factory_make("rtpjitterbuffer", nullptr);
+    GstElement *audiortpjitterbuffer = gst_element_factory_make("rtpjitterbuffer", "jitterbuffer");
 
     gst_bin_add(GST_BIN(bin), audiortpjitterbuffer);
     gst_bin_add(GST_BIN(bin), audiortpdepay);
@@ -416,6 +514,10 @@ GstElement *bins_audiodec_create(const QString &codec)
 
     g_object_set(G_OBJECT(audiortpjitterbuffer), "latency", (unsigned int)get_rtp_latency(), NULL);
 
+    // lost packets have to be reported for the decoder to recover them
+    if (codec == "opus")
+        g_object_set(G_OBJECT(audiortpjitterbuffer), "do-lost", TRUE, NULL);
+
     GstPad *pad;
 
     pad = gst_element_get_static_pad(audiortpjitterbuffer, "sink");
@@ -438,7 +540,7 @@ GstElement *bins_videodec_create(const QString &codec)
     if (!video_codec_get_recv_elements(codec, &videodec, &videortpdepay))
         return nullptr;
 
-    GstElement *videortpjitterbuffer = gst_element_factory_make("rtpjitterbuffer", nullptr);
+    GstElement *videortpjitterbuffer = gst_element_factory_make("rtpjitterbuffer", "jitterbuffer");
 
     gst_bin_add(GST_BIN(bin), videortpjitterbuffer);
     gst_bin_add(GST_BIN(bin), videortpdepay);
@@ -461,4 +563,44 @@ GstElement *bins_videodec_create(const QString &codec)
     return bin;
 }
 
+GstElement *bins_rtpdepay_create(const QString &codec, bool video)
+{
+    GstElement *rtpdepay = video ? video_codec_to_rtpdepay_element(codec) : audio_codec_to_rtpdepay_element(codec);
+    if (!rtpdepay)
+        return nullptr;
+
+    GstElement *bin             = gst_bin_new(nullptr);
+    GstElement *rtpjitterbuffer = gst_element_factory_make("rtpjitterbuffer", nullptr);
+
+    gst_bin_add(GST_BIN(bin), rtpjitterbuffer);
+    gst_bin_add(GST_BIN(bin), rtpdepay);
+    gst_element_link(rtpjitterbuffer, rtpdepay);
+
+    g_object_set(G_OBJECT(rtpjitterbuffer), "latency", (unsigned int)get_rtp_latency(), NULL);
+
+    // rtp doesn't carry the opus stream headers a container needs, the
+    //   parser makes them up
+    GstElement *last = rtpdepay;
+    if (codec == "opus") {
+        GstElement *parse = gst_element_factory_make("opusparse", nullptr);
+        if (parse) {
+            gst_bin_add(GST_BIN(bin), parse);
+            gst_element_link(rtpdepay, parse);
+            last = parse;
+        }
+    }
+
+    GstPad *pad;
+
+    pad = gst_element_get_static_pad(rtpjitterbuffer, "sink");
+    gst_element_add_pad(bin, gst_ghost_pad_new("sink", pad));
+    gst_object_unref(GST_OBJECT(pad));
+
+    pad = gst_element_get_static_pad(last, "src");
+    gst_element_add_pad(bin, gst_ghost_pad_new("src", pad));
+    gst_object_unref(GST_OBJECT(pad));
+
+    return bin;
+}
+
 }
@@ -28,13 +28,18 @@ class QSize;
 
 namespace PsiMedia {
 
-GstElement *bins_videoprep_create(const QSize &size, int fps, bool is_live);
+class PAudioParams;
 
-GstElement *bins_audioenc_create(const QString &codec, int id, int rate, int size, int channels);
+GstElement *bins_videoprep_create(const QString &codec, const QSize &size, int fps, bool is_live);
+
+GstElement *bins_audioenc_create(const PAudioParams &params, int id);
 GstElement *bins_videoenc_create(const QString &codec, int id, int maxkbps);
 GstElement *bins_audiodec_create(const QString &codec);
 GstElement *bins_videodec_create(const QString &codec);
 
+// rtp in, the encoded stream out, for storing it as it is
+GstElement *bins_rtpdepay_create(const QString &codec, bool video);
+
 }
 
 #endif
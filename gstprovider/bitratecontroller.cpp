@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+#include "bitratecontroller.h"
+
+#include <QtGlobal>
+
+// never go below this, theora looks awful anyway at that point
+#define MIN_VIDEO_KBPS 48
+#define MIN_VIDEO_FPS 5
+
+// loss thresholds, as in gcc
+#define LOSS_HIGH 0.10
+#define LOSS_LOW 0.02
+
+// growth per clean report
+#define INCREASE_FACTOR 1.08
+
+// round trip above the lowest seen that counts as congestion, and how much
+//   to back off then
+#define RTT_CONGESTED_MS 100
+#define DELAY_DECREASE_FACTOR 0.85
+
+// reports to wait after backing off before probing upwards again
+#define HOLD_REPORTS 2
+
+namespace PsiMedia {
+
+BitrateController::BitrateController(int maxKbps, int maxFps) :
+    minKbps_(qMin(MIN_VIDEO_KBPS, maxKbps)), maxKbps_(maxKbps), minFps_(qMin(MIN_VIDEO_FPS, maxFps)),
+    maxFps_(maxFps), kbps_(maxKbps), fps_(maxFps), minRtt_(-1), holdReports_(0)
+{
+}
+
+bool BitrateController::update(double loss, int roundTripMs)
+{
+    int oldKbps = kbps_;
+    int oldFps  = fps_;
+
+    double rate      = kbps_;
+    bool   decreased = false;
+
+    if (loss > LOSS_HIGH) {
+        rate *= 1 - 0.5 * loss;
+        decreased = true;
+    }
+
+    if (roundTripMs >= 0) {
+        if (minRtt_ == -1 || roundTripMs < minRtt_)
+            minRtt_ = roundTripMs;
+        else if (roundTripMs - minRtt_ > RTT_CONGESTED_MS && !decreased) {
+            rate *= DELAY_DECREASE_FACTOR;
+            decreased = true;
+        }
+    }
+
+    bool increase = false;
+    if (decreased)
+        holdReports_ = HOLD_REPORTS;
+    else if (holdReports_ > 0)
+        --holdReports_;
+    else if (loss >= 0 && loss < LOSS_LOW)
+        increase = true;
+
+    if (maxFps_ > 0 && decreased && kbps_ == minKbps_) {
+        // nothing left to take from the bitrate, drop frames instead
+        fps_ = qMax(minFps_, fps_ * 3 / 4);
+    } else if (maxFps_ > 0 && increase && fps_ < maxFps_) {
+        // and get them back before spending more on each frame
+        fps_ = qMin(maxFps_, fps_ * 4 / 3 + 1);
+    } else {
+        if (increase)
+            rate *= INCREASE_FACTOR;
+        kbps_ = qBound(minKbps_, int(rate), maxKbps_);
+    }
+
+    return kbps_ != oldKbps || fps_ != oldFps;
+}
+
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+#ifndef PSI_BITRATECONTROLLER_H
+#define PSI_BITRATECONTROLLER_H
+
+namespace PsiMedia {
+
+// decides the video sending rate from what the remote reports back over
+//   rtcp.  the idea is the same as google congestion control, in a much
+//   simplified form:
+//   - loss based: back off proportionally when a lot is lost, probe upwards
+//     slowly when almost nothing is
+//   - delay based: a round trip growing well above the lowest one seen means
+//     queues are filling up somewhere, so back off before loss starts
+//
+// the rate stays within [minimum, maximum], where maximum is the configured
+//   cap.  once it sits at the minimum and the network still wants less, the
+//   frame rate goes down instead, and it comes back up before the bitrate
+//   does.  the frames are only dropped, the caps (and so the theora headers)
+//   keep the nominal rate.  maxFps of -1 leaves the frame rate alone.
+class BitrateController {
+public:
+    BitrateController(int maxKbps, int maxFps = -1);
+
+    // feed a new receiver report.  loss is the fraction lost (0-1), and
+    //   roundTripMs is -1 if unknown.  returns true if kbps() or fps()
+    //   changed.
+    bool update(double loss, int roundTripMs);
+
+    int kbps() const { return kbps_; }
+    int fps() const { return fps_; }
+
+private:
+    int minKbps_;
+    int maxKbps_;
+    int minFps_;
+    int maxFps_;
+    int kbps_;
+    int fps_;
+    int minRtt_;
+    int holdReports_; // no increases for this many reports after a decrease
+};
+
+}
+
+#endif
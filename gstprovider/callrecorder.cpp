@@ -0,0 +1,313 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+#include "callrecorder.h"
+
+#include "bins.h"
+#include "payloadinfo.h"
+#include <gst/app/gstappsrc.h>
+
+// rtp queued for the recording beyond this is dropped, oldest first (ms)
+#define RECORDER_QUEUE_TIME 1000
+
+// a stored stream quiet for this long is told there is a gap, so the muxer
+//   doesn't hold the others back waiting for it (ms)
+#define RECORDER_GAP_TIME 200
+
+namespace PsiMedia {
+
+CallRecorder::CallRecorder(void (*data)(const QByteArray &buf, void *app), void *_app) : cb_data(data), app(_app) { }
+
+CallRecorder::~CallRecorder()
+{
+    if (pipeline) {
+        gst_element_set_state(pipeline, GST_STATE_NULL);
+        gst_element_get_state(pipeline, nullptr, nullptr, GST_CLOCK_TIME_NONE);
+        g_object_unref(G_OBJECT(pipeline));
+    }
+}
+
+bool CallRecorder::start(Mode mode, const PPayloadInfo &sentAudioInfo, const PPayloadInfo &receivedAudioInfo,
+                         const PPayloadInfo &sentVideoInfo, const PPayloadInfo &receivedVideoInfo)
+{
+    pipeline = gst_pipeline_new(nullptr);
+
+    muxer            = gst_element_factory_make("oggmux", nullptr);
+    GstElement *sink = gst_element_factory_make("appsink", nullptr);
+    if (!muxer || !sink) {
+        for (GstElement *e : { muxer, sink })
+            if (e)
+                g_object_unref(G_OBJECT(e));
+        return false;
+    }
+
+    g_object_set(G_OBJECT(sink), "sync", FALSE, "async", FALSE, nullptr);
+
+    GstAppSinkCallbacks sinkCb = {};
+    sinkCb.new_sample          = cb_new_sample;
+    sinkCb.eos                 = cb_eos;
+    sinkCb.new_preroll         = cb_new_preroll;
+    gst_app_sink_set_callbacks(reinterpret_cast<GstAppSink *>(sink), &sinkCb, this, nullptr);
+
+    gst_bin_add_many(GST_BIN(pipeline), muxer, sink, nullptr);
+    gst_element_link(muxer, sink);
+
+    QMutexLocker locker(&m);
+    int          streams = 0;
+    if (mode == Mixed) {
+        GstElement *mixer   = gst_element_factory_make("audiomixer", nullptr);
+        GstElement *convert = gst_element_factory_make("audioconvert", nullptr);
+        GstElement *encoder = gst_element_factory_make("opusenc", nullptr);
+        if (!mixer || !convert || !encoder) {
+            for (GstElement *e : { mixer, convert, encoder })
+                if (e)
+                    g_object_unref(G_OBJECT(e));
+            return false;
+        }
+
+        gst_bin_add_many(GST_BIN(pipeline), mixer, convert, encoder, nullptr);
+        gst_element_link_many(mixer, convert, encoder, muxer, nullptr);
+
+        streams += addMixedStream(&sentAudio, sentAudioInfo, mixer);
+        streams += addMixedStream(&receivedAudio, receivedAudioInfo, mixer);
+    } else {
+        stored = true;
+        streams += addStoredStream(&sentAudio, sentAudioInfo, false);
+        streams += addStoredStream(&receivedAudio, receivedAudioInfo, false);
+        streams += addStoredStream(&sentVideo, sentVideoInfo, true);
+        streams += addStoredStream(&receivedVideo, receivedVideoInfo, true);
+    }
+    if (streams == 0)
+        return false;
+
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+    return true;
+}
+
+// appsrc ! queue, for the rtp of a stream
+GstElement *CallRecorder::addSource(Stream *stream, const PPayloadInfo &info, const char *media)
+{
+    GstStructure *cs = payloadInfoToStructure(info, media);
+    if (!cs)
+        return nullptr;
+
+    GstElement *src   = gst_element_factory_make("appsrc", nullptr);
+    GstElement *queue = gst_element_factory_make("queue", nullptr);
+
+    GstCaps *caps = gst_caps_new_empty();
+    gst_caps_append_structure(caps, cs);
+    g_object_set(G_OBJECT(src), "caps", caps, "is-live", TRUE, "format", GST_FORMAT_TIME, "do-timestamp", TRUE,
+                 nullptr);
+    gst_caps_unref(caps);
+
+    // leaky, so a slow recording loses packets rather than holding anyone
+    //   up.  the muxer holding a stream back while another is quiet doesn't
+    //   count, see advanceQuietStreams().
+    g_object_set(G_OBJECT(queue), "max-size-buffers", 0, "max-size-bytes", 0, "max-size-time",
+                 guint64(RECORDER_QUEUE_TIME) * GST_MSECOND, nullptr);
+    gst_util_set_object_arg(G_OBJECT(queue), "leaky", "downstream");
+
+    gst_bin_add_many(GST_BIN(pipeline), src, queue, nullptr);
+    gst_element_link(src, queue);
+
+    stream->appsrc = src;
+    stream->pt     = info.id;
+    return queue;
+}
+
+// source ! audiodecbin ! audioconvert ! audioresample ! mixer
+bool CallRecorder::addMixedStream(Stream *stream, const PPayloadInfo &info, GstElement *mixer)
+{
+    if (info.id == -1)
+        return false;
+
+    GstElement *decoder = bins_audiodec_create(info.name.toLower());
+    if (!decoder)
+        return false;
+    gst_object_set_name(GST_OBJECT(decoder), nullptr); // one per direction
+
+    GstElement *src = addSource(stream, info, "audio");
+    if (!src) {
+        g_object_unref(G_OBJECT(decoder));
+        return false;
+    }
+
+    GstElement *convert  = gst_element_factory_make("audioconvert", nullptr);
+    GstElement *resample = gst_element_factory_make("audioresample", nullptr);
+
+    gst_bin_add_many(GST_BIN(pipeline), decoder, convert, resample, nullptr);
+    gst_element_link_many(src, decoder, convert, resample, mixer, nullptr);
+    return true;
+}
+
+// source ! depayloader ! muxer.  every stream gets its muxer pad here, as
+//   ogg wants all of its streams to begin before any data.
+bool CallRecorder::addStoredStream(Stream *stream, const PPayloadInfo &info, bool video)
+{
+    if (info.id == -1)
+        return false;
+
+    GstElement *depay = bins_rtpdepay_create(info.name.toLower(), video);
+    if (!depay)
+        return false;
+
+    GstElement *src = addSource(stream, info, video ? "video" : "audio");
+    if (!src) {
+        g_object_unref(G_OBJECT(depay));
+        return false;
+    }
+
+    gst_bin_add(GST_BIN(pipeline), depay);
+    gst_element_link_many(src, depay, muxer, nullptr);
+    return true;
+}
+
+void CallRecorder::stop()
+{
+    QMutexLocker locker(&m);
+    for (Stream *stream : { &sentAudio, &receivedAudio, &sentVideo, &receivedVideo }) {
+        if (stream->appsrc)
+            gst_app_src_end_of_stream(reinterpret_cast<GstAppSrc *>(stream->appsrc));
+        stream->appsrc = nullptr;
+    }
+}
+
+bool CallRecorder::isFinished()
+{
+    QMutexLocker locker(&m);
+    return finished;
+}
+
+bool CallRecorder::waitForFinished(int msecs)
+{
+    // finished is set as the empty array goes out.  if it is on its way,
+    //   deleting us waits for the streaming thread delivering it.
+    QMutexLocker locker(&m);
+    if (finished || finishedCond.wait(&m, ulong(msecs)))
+        return true;
+
+    cut      = true;
+    finished = true;
+    return false;
+}
+
+void CallRecorder::pushAudio(bool sent, const QByteArray &rtp) { push(sent ? &sentAudio : &receivedAudio, rtp); }
+
+void CallRecorder::pushVideo(bool sent, const QByteArray &rtp) { push(sent ? &sentVideo : &receivedVideo, rtp); }
+
+void CallRecorder::push(Stream *stream, const QByteArray &rtp)
+{
+    if (rtp.size() < 12 || (quint8(rtp[1]) & 0x7f) != stream->pt)
+        return;
+
+    QMutexLocker locker(&m);
+    if (!stream->appsrc)
+        return;
+
+    GstBuffer *buffer = gst_buffer_new_allocate(nullptr, gsize(rtp.size()), nullptr);
+    gst_buffer_fill(buffer, 0, rtp.constData(), gsize(rtp.size()));
+    gst_app_src_push_buffer(reinterpret_cast<GstAppSrc *>(stream->appsrc), buffer);
+
+    if (stored) {
+        GstClockTime now   = GST_CLOCK_TIME_NONE;
+        GstClock *   clock = gst_element_get_clock(pipeline);
+        if (clock) {
+            now = gst_clock_get_time(clock) - gst_element_get_base_time(pipeline);
+            gst_object_unref(clock);
+        }
+        if (GST_CLOCK_TIME_IS_VALID(now)) {
+            stream->covered = now;
+            advanceQuietStreams(now);
+        }
+    }
+}
+
+// the muxer only goes on once every stream has something up to the same
+//   time.  a stream that has nothing to say, video the peer doesn't send
+//   or audio in silence, gets gap events instead, driven by the streams
+//   that do have data.  called with the lock held.
+void CallRecorder::advanceQuietStreams(GstClockTime now)
+{
+    for (Stream *stream : { &sentAudio, &receivedAudio, &sentVideo, &receivedVideo }) {
+        if (!stream->appsrc || now < stream->covered + GstClockTime(RECORDER_GAP_TIME) * GST_MSECOND)
+            continue;
+
+        // serialized, so it goes out in order with the data
+        gst_element_send_event(stream->appsrc, gst_event_new_gap(stream->covered, now - stream->covered));
+        stream->covered = now;
+    }
+}
+
+void CallRecorder::finish()
+{
+    m.lock();
+    bool wasFinished = finished;
+    finished         = true;
+    m.unlock();
+
+    if (!wasFinished)
+        cb_data(QByteArray(), app);
+
+    // only now, so the empty array is out before anyone waiting goes on
+    QMutexLocker locker(&m);
+    finishedCond.wakeAll();
+}
+
+GstFlowReturn CallRecorder::cb_new_sample(GstAppSink *appsink, gpointer data)
+{
+    return static_cast<CallRecorder *>(data)->new_sample(appsink);
+}
+
+GstFlowReturn CallRecorder::cb_new_preroll(GstAppSink *appsink, gpointer data)
+{
+    Q_UNUSED(appsink);
+    Q_UNUSED(data);
+    return GST_FLOW_OK;
+}
+
+void CallRecorder::cb_eos(GstAppSink *appsink, gpointer data)
+{
+    Q_UNUSED(appsink);
+    static_cast<CallRecorder *>(data)->finish();
+}
+
+GstFlowReturn CallRecorder::new_sample(GstAppSink *appsink)
+{
+    GstSample *sample = gst_app_sink_pull_sample(appsink);
+    if (!sample)
+        return GST_FLOW_OK;
+
+    GstBuffer *buffer = gst_sample_get_buffer(sample);
+    int        sz     = int(gst_buffer_get_size(buffer));
+    QByteArray ba;
+    ba.resize(sz);
+    gst_buffer_extract(buffer, 0, ba.data(), gsize(sz));
+    gst_sample_unref(sample);
+
+    m.lock();
+    bool stopped = cut;
+    m.unlock();
+
+    if (!ba.isEmpty() && !stopped)
+        cb_data(ba, app);
+    return GST_FLOW_OK;
+}
+
+}
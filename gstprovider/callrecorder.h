@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+#ifndef PSI_CALLRECORDER_H
+#define PSI_CALLRECORDER_H
+
+#include "psimediaprovider.h"
+#include <QByteArray>
+#include <QMutex>
+#include <QWaitCondition>
+#include <gst/app/gstappsink.h>
+#include <gst/gst.h>
+
+namespace PsiMedia {
+
+// records a call to ogg from its rtp, what is sent and what is received.
+//   it runs in a pipeline of its own, so the session's pipelines never wait
+//   for it: packets are queued to it, and the oldest queued ones are
+//   dropped if it falls behind.
+class CallRecorder {
+public:
+    enum Mode {
+        // the encoded streams are stored as they are, each its own stream
+        //   in the ogg.  next to no cost.
+        Passthrough,
+
+        // the audio of both sides is decoded, mixed and encoded again into
+        //   one opus stream, which any player plays in full.  no video.
+        Mixed
+    };
+
+    // data is called from a streaming thread with the muxed recording, and
+    //   with an empty array once it is complete or has failed
+    CallRecorder(void (*data)(const QByteArray &buf, void *app), void *app);
+    ~CallRecorder();
+
+    // the opus and theora payloads sent and received.  any may be left out
+    //   (id -1), returns false if there is nothing to record.
+    bool start(Mode mode, const PPayloadInfo &sentAudio, const PPayloadInfo &receivedAudio,
+               const PPayloadInfo &sentVideo, const PPayloadInfo &receivedVideo);
+
+    // end the recording.  the rest of it is still delivered after this.
+    void stop();
+
+    // whether the empty array was delivered
+    bool isFinished();
+
+    // after stop(), wait up to msecs for the rest to be delivered.  if it
+    //   takes longer, nothing more is delivered, not even the empty array,
+    //   and false is returned.
+    bool waitForFinished(int msecs);
+
+    // may be called from any thread.  packets of other payload types are
+    //   ignored.
+    void pushAudio(bool sent, const QByteArray &rtp);
+    void pushVideo(bool sent, const QByteArray &rtp);
+
+private:
+    class Stream {
+    public:
+        GstElement * appsrc  = nullptr;
+        int          pt      = -1;
+        GstClockTime covered = 0; // running time the stream has data or a gap up to
+    };
+
+    void (*cb_data)(const QByteArray &buf, void *app);
+    void *         app;
+    GstElement *   pipeline = nullptr;
+    GstElement *   muxer    = nullptr;
+    QMutex         m;
+    QWaitCondition finishedCond;
+    Stream         sentAudio, receivedAudio; // guarded
+    Stream         sentVideo, receivedVideo; // guarded
+    bool           stored   = false;         // passthrough, the muxer waits for every stream
+    bool           finished = false;         // guarded
+    bool           cut      = false;         // guarded, gave up waiting for the rest
+
+    GstElement *addSource(Stream *stream, const PPayloadInfo &info, const char *media);
+    bool        addMixedStream(Stream *stream, const PPayloadInfo &info, GstElement *mixer);
+    bool        addStoredStream(Stream *stream, const PPayloadInfo &info, bool video);
+    void        push(Stream *stream, const QByteArray &rtp);
+    void        advanceQuietStreams(GstClockTime now);
+    void        finish();
+
+    static GstFlowReturn cb_new_sample(GstAppSink *appsink, gpointer data);
+    static GstFlowReturn cb_new_preroll(GstAppSink *appsink, gpointer data);
+    static void          cb_eos(GstAppSink *appsink, gpointer data);
+
+    GstFlowReturn new_sample(GstAppSink *appsink);
+};
+
+}
+
+#endif
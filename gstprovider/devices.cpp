@@ -21,6 +21,8 @@
 #include "devices.h"
 
 #include "gstthread.h"
+#include <QElapsedTimer>
+#include <QHash>
 #include <QMap>
 #include <QMutex>
 #include <QSet>
@@ -146,6 +148,44 @@ static gchar *get_launch_line(::GstDevice *device)
     return g_string_free(launch_line, FALSE);
 }
 
+// the handles of the devices the monitor knows, by id, for making elements
+static QMutex                                      device_handles_mutex;
+static QHash<QString, QSharedPointer<::GstDevice>> device_handles;
+
+static void device_handles_update(const GstDevice &dev, bool present)
+{
+    if (!dev.handle)
+        return;
+
+    QMutexLocker locker(&device_handles_mutex);
+    if (present)
+        device_handles.insert(dev.id, dev.handle);
+    else
+        device_handles.remove(dev.id);
+}
+
+// what tells one device apart from another without making an element for
+//   it.  providers may hand out new objects for the same device on every
+//   probe, so it's the contents.
+static QString device_key(::GstDevice *gdev)
+{
+    gchar *name  = gst_device_get_display_name(gdev);
+    gchar *klass = gst_device_get_device_class(gdev);
+
+    QString key = QString::fromUtf8(name) + '\n' + QString::fromUtf8(klass);
+    g_free(name);
+    g_free(klass);
+
+    GstStructure *props = gst_device_get_properties(gdev);
+    if (props) {
+        gchar *s = gst_structure_to_string(props);
+        key += '\n' + QString::fromUtf8(s);
+        g_free(s);
+        gst_structure_free(props);
+    }
+    return key;
+}
+
 class DeviceMonitor::Private {
 public:
     DeviceMonitor *          q;
@@ -153,6 +193,20 @@ public:
     QMap<QString, GstDevice> _devices;
     PlatformDeviceMonitor *  _platform = nullptr;
     QMutex                   m;
+    GThread *                scanThread = nullptr;
+
+    // devices removed while the first scan runs, which the scan may still
+    //   have seen.  guarded by m.
+    bool          scanning = true;
+    QSet<QString> removedWhileScanning;
+
+    // ids by device_key(), empty for devices we don't offer.  working out
+    //   an id takes making elements, so it's done once per device rather
+    //   than on every scan and hotplug event.  a device going away takes
+    //   its entry along, or every plug cycle of a changing device would
+    //   leave one behind.
+    QMutex                  ids_mutex;
+    QHash<QString, QString> ids;
 
     bool videoSrcFirst  = true;
     bool audioSrcFirst  = true;
@@ -160,23 +214,39 @@ public:
 
     Private(DeviceMonitor *q) : q(q) {}
 
-    static GstDevice gstDevConvert(::GstDevice *gdev)
+    static gpointer scan(gpointer data)
+    {
+        static_cast<DeviceMonitor::Private *>(data)->q->updateDevList();
+        return nullptr;
+    }
+
+    GstDevice gstDevConvert(::GstDevice *gdev)
     {
         PsiMedia::GstDevice d;
 
-        gchar *ll = get_launch_line(gdev);
-        if (ll) {
-            auto e = gst_parse_launch(ll, nullptr);
-            if (e) {
+        // the id is the launch line, which is what saved settings refer to
+        QString key = device_key(gdev);
+        ids_mutex.lock();
+        bool known = ids.contains(key);
+        d.id       = ids.value(key);
+        ids_mutex.unlock();
+
+        if (!known) {
+            gchar *ll = get_launch_line(gdev);
+            if (ll) {
                 d.id = QString::fromUtf8(ll);
-                gst_object_unref(e);
+                g_free(ll);
             }
-            g_free(ll);
-            if (d.id.isEmpty() || d.id.endsWith(QLatin1String(".monitor"))) {
+            if (d.id.endsWith(QLatin1String(".monitor")))
                 d.id.clear();
-                return d;
-            }
+
+            QMutexLocker locker(&ids_mutex);
+            ids.insert(key, d.id);
         }
+        if (d.id.isEmpty())
+            return d;
+
+        d.handle = QSharedPointer<::GstDevice>(static_cast<::GstDevice *>(gst_object_ref(gdev)), gst_object_unref);
 
         gchar *name = gst_device_get_display_name(gdev);
         d.name      = QString::fromUtf8(name);
@@ -207,14 +277,17 @@ public:
         switch (GST_MESSAGE_TYPE(message)) {
         case GST_MESSAGE_DEVICE_ADDED:
             gst_message_parse_device_added(message, &device);
-            d = gstDevConvert(device);
+            d = monObj->gstDevConvert(device);
             gst_object_unref(device);
             if (!d.id.isEmpty())
                 monObj->q->onDeviceAdded(d);
             break;
         case GST_MESSAGE_DEVICE_REMOVED:
             gst_message_parse_device_removed(message, &device);
-            d = gstDevConvert(device);
+            d = monObj->gstDevConvert(device);
+            monObj->ids_mutex.lock();
+            monObj->ids.remove(device_key(device));
+            monObj->ids_mutex.unlock();
             gst_object_unref(device);
             if (!d.id.isEmpty())
                 monObj->q->onDeviceRemoved(d);
@@ -227,32 +300,49 @@ public:
     }
 };
 
+// runs in the scan thread
 void DeviceMonitor::updateDevList()
 {
-    d->_devices.clear();
-    GList *devs = gst_device_monitor_get_devices(d->_monitor);
-    GList *dev  = devs;
+    QElapsedTimer scanTime;
+    scanTime.start();
+
+    QMap<QString, GstDevice> devices;
+    GList *                  devs = gst_device_monitor_get_devices(d->_monitor);
+    GList *                  dev  = devs;
 
     for (; dev != nullptr; dev = dev->next) {
-        PsiMedia::GstDevice pdev = Private::gstDevConvert(static_cast<::GstDevice *>(dev->data));
+        PsiMedia::GstDevice pdev = d->gstDevConvert(static_cast<::GstDevice *>(dev->data));
         if (pdev.id.isEmpty())
             continue;
-        d->_devices.insert(pdev.id, pdev);
+        devices.insert(pdev.id, pdev);
     }
-    g_list_free(devs);
+    g_list_free_full(devs, gst_object_unref);
 
     if (d->_platform) {
         auto l = d->_platform->getDevices();
         for (auto const &pdev : l) {
-            if (!d->_devices.contains(pdev.id)) {
-                d->_devices.insert(pdev.id, pdev);
+            if (!devices.contains(pdev.id)) {
+                devices.insert(pdev.id, pdev);
             }
         }
     }
 
-    for (auto const &pdev : d->_devices) {
-        qDebug("found dev: %s (%s)", qPrintable(pdev.name), qPrintable(pdev.id));
+    // devices added while we were scanning are known already, and those
+    //   removed meanwhile are gone
+    QMutexLocker locker(&d->m);
+    for (auto const &pdev : devices) {
+        if (!d->_devices.contains(pdev.id) && !d->removedWhileScanning.contains(pdev.id)) {
+            d->_devices.insert(pdev.id, pdev);
+            device_handles_update(pdev, true);
+            qDebug("found dev: %s (%s)", qPrintable(pdev.name), qPrintable(pdev.id));
+        }
     }
+    qDebug("device scan took %lld ms", scanTime.elapsed());
+    d->scanning = false;
+    d->removedWhileScanning.clear();
+    locker.unlock();
+
+    emit updated();
 }
 
 void DeviceMonitor::onDeviceAdded(GstDevice dev)
@@ -261,6 +351,7 @@ void DeviceMonitor::onDeviceAdded(GstDevice dev)
     if (d->_devices.contains(dev.id)) {
         qWarning("Double added of device %s (%s)", qPrintable(dev.name), qPrintable(dev.id));
     } else {
+        d->removedWhileScanning.remove(dev.id);
         switch (dev.type) {
         case PDevice::AudioIn:
             dev.isDefault    = d->audioSrcFirst;
@@ -276,6 +367,7 @@ void DeviceMonitor::onDeviceAdded(GstDevice dev)
             break;
         }
         d->_devices.insert(dev.id, dev);
+        device_handles_update(dev, true);
         qDebug("added dev: %s (%s)", qPrintable(dev.name), qPrintable(dev.id));
         emit updated();
     }
@@ -284,10 +376,14 @@ void DeviceMonitor::onDeviceAdded(GstDevice dev)
 void DeviceMonitor::onDeviceRemoved(const GstDevice &dev)
 {
     QMutexLocker locker(&d->m);
+    if (d->scanning)
+        d->removedWhileScanning.insert(dev.id);
+
     if (d->_devices.remove(dev.id)) {
+        device_handles_update(dev, false);
         qDebug("removed dev: %s (%s)", qPrintable(dev.name), qPrintable(dev.id));
         emit updated();
-    } else {
+    } else if (!d->scanning) {
         qWarning("Double remove of device %s (%s)", qPrintable(dev.name), qPrintable(dev.id));
     }
 }
@@ -321,17 +417,28 @@ DeviceMonitor::DeviceMonitor(GstMainLoop *mainLoop) : d(new Private(this))
     gst_device_monitor_add_filter(d->_monitor, "Video/Source", caps);
     gst_caps_unref(caps);
 
-    updateDevList();
     if (!gst_device_monitor_start(d->_monitor)) {
         qWarning("failed to start device monitor");
     }
+
+    // the first scan probes every device provider, which can take seconds.
+    //   it runs in a thread of its own, so neither startup nor the sessions
+    //   wait for it, and updated() is emitted once it is done.  the monitor
+    //   is started first, so nothing plugged in meanwhile is missed.
+    d->scanThread = g_thread_new("psimedia-devscan", Private::scan, d);
 }
 
 DeviceMonitor::~DeviceMonitor()
 {
+    g_thread_join(d->scanThread);
     delete d->_platform;
     gst_device_monitor_stop(d->_monitor);
     g_object_unref(d->_monitor);
+
+    device_handles_mutex.lock();
+    device_handles.clear();
+    device_handles_mutex.unlock();
+
     delete d;
 }
 
@@ -351,6 +458,14 @@ GstElement *devices_makeElement(const QString &id, PDevice::Type type, QSize *ca
 {
     Q_UNUSED(type);
     Q_UNUSED(captureSize);
+
+    device_handles_mutex.lock();
+    QSharedPointer<::GstDevice> handle = device_handles.value(id);
+    device_handles_mutex.unlock();
+    if (handle)
+        return gst_device_create_element(handle.data(), nullptr);
+
+    // platform devices, and ones that aren't around anymore
     return gst_parse_launch(id.toLatin1().data(), nullptr);
     // TODO check if it correponds to passed type.
     // TODO drop captureSize
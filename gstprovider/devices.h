@@ -23,7 +23,9 @@
 
 #include "psimediaprovider.h"
 #include <QList>
+#include <QSharedPointer>
 #include <QString>
+#include <gst/gstdevice.h>
 #include <gst/gstelement.h>
 
 class QSize;
@@ -38,6 +40,9 @@ public:
     QString       name;
     bool          isDefault = false; // TODO assign true somewhere
     QString       id;
+
+    // the device as gstreamer knows it, if it came from the device monitor
+    QSharedPointer<::GstDevice> handle;
 };
 
 class PlatformDeviceMonitor {
@@ -68,6 +73,8 @@ public:
     QList<GstDevice> devices(PDevice::Type type);
 };
 
+// creates the element from the device's handle if it is a known one, or
+//   else by parsing the id as a launch line
 GstElement *devices_makeElement(const QString &id, PDevice::Type type, QSize *captureSize = nullptr);
 
 }
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+
+#include "deviceswap.h"
+
+namespace PsiMedia {
+
+DeviceSwap::DeviceSwap(PDevice::Type type, PipelineDeviceContext *from, GMainContext *mainContext) :
+    type_(type), from_(from), mainContext_(mainContext)
+{
+}
+
+DeviceSwap::~DeviceSwap()
+{
+    if (pad)
+        gst_object_unref(pad);
+    if (oldPad)
+        gst_object_unref(oldPad);
+    if (newPad)
+        gst_object_unref(newPad);
+}
+
+PDevice::Type DeviceSwap::type() const { return type_; }
+
+bool DeviceSwap::start(PipelineContext *pipeline, const QString &id, const PipelineDeviceOptions &opts)
+{
+    to_ = PipelineDeviceContext::create(pipeline, id, type_, opts);
+    if (!to_)
+        return false;
+
+    const char *name = type_ == PDevice::AudioOut ? "sink" : "src";
+    oldPad           = gst_element_get_static_pad(from_->element(), name);
+    newPad           = gst_element_get_static_pad(to_->element(), name);
+    if (type_ == PDevice::AudioOut)
+        pad = gst_pad_get_peer(oldPad);
+    else
+        pad = static_cast<GstPad *>(gst_object_ref(newPad));
+
+    // a sink has to be running before anything reaches it, a source must
+    //   not push anything before the switch
+    if (!pad || (type_ == PDevice::AudioOut && !to_->activate()))
+        return false;
+
+    m.lock();
+    refs.ref();
+    probe = gst_pad_add_probe(pad, GstPadProbeType(GST_PAD_PROBE_TYPE_BLOCK | GST_PAD_PROBE_TYPE_BUFFER),
+                              cb_swap_probe, this, cb_swap_probe_removed);
+    m.unlock();
+
+    return type_ == PDevice::AudioOut || to_->activate();
+}
+
+PipelineDeviceContext *DeviceSwap::finish()
+{
+    // with the probe gone, the switch has either happened or never will
+    m.lock();
+    if (probe) {
+        gst_pad_remove_probe(pad, probe);
+        probe = 0;
+    }
+    if (timer) {
+        g_source_destroy(timer);
+        g_source_unref(timer);
+        timer = nullptr;
+    }
+    bool done = switched;
+    m.unlock();
+
+    PipelineDeviceContext *device;
+    if (done) {
+        delete from_;
+        device = to_;
+    } else {
+        delete to_;
+        device = from_;
+    }
+
+    release();
+    return device;
+}
+
+GstPadProbeReturn DeviceSwap::cb_swap_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+    Q_UNUSED(pad)
+    Q_UNUSED(info)
+    return static_cast<DeviceSwap *>(data)->swap_probe();
+}
+
+// gstreamer doesn't wait for a running probe callback when the probe is
+//   removed, so the swap lives on until the probe is really gone
+void DeviceSwap::cb_swap_probe_removed(gpointer data) { static_cast<DeviceSwap *>(data)->release(); }
+
+GstPadProbeReturn DeviceSwap::cb_drop_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+    Q_UNUSED(pad)
+    Q_UNUSED(info)
+    Q_UNUSED(data)
+    return GST_PAD_PROBE_DROP;
+}
+
+gboolean DeviceSwap::cb_switched_timeout(gpointer data) { return static_cast<DeviceSwap *>(data)->switched_timeout(); }
+
+// runs in the streaming thread of the probed pad
+GstPadProbeReturn DeviceSwap::swap_probe()
+{
+    QMutexLocker locker(&m);
+
+    // given up on while we waited for the lock
+    if (!probe)
+        return GST_PAD_PROBE_REMOVE;
+
+    if (type_ == PDevice::AudioOut) {
+        gst_pad_unlink(pad, oldPad);
+        gst_pad_link(pad, newPad);
+    } else {
+        // whatever the old source still has is dropped, rather than pushed
+        //   into nothing
+        gst_pad_add_probe(oldPad, GST_PAD_PROBE_TYPE_DATA_DOWNSTREAM, cb_drop_probe, nullptr, nullptr);
+
+        GstPad *peer = gst_pad_get_peer(oldPad);
+        if (peer) {
+            gst_pad_unlink(oldPad, peer);
+            gst_pad_link(newPad, peer);
+            gst_object_unref(peer);
+        }
+    }
+    switched = true;
+    probe    = 0;
+
+    timer = g_timeout_source_new(0);
+    g_source_set_callback(timer, cb_switched_timeout, this, nullptr);
+    g_source_attach(timer, mainContext_);
+    return GST_PAD_PROBE_REMOVE;
+}
+
+gboolean DeviceSwap::switched_timeout()
+{
+    m.lock();
+    g_source_unref(timer);
+    timer = nullptr;
+    m.unlock();
+
+    if (cb_switched)
+        cb_switched(this, app);
+    return FALSE;
+}
+
+void DeviceSwap::release()
+{
+    if (!refs.deref())
+        delete this;
+}
+
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+
+#ifndef PSI_DEVICESWAP_H
+#define PSI_DEVICESWAP_H
+
+#include "pipeline.h"
+#include <QAtomicInt>
+#include <QMutex>
+#include <gst/gst.h>
+
+namespace PsiMedia {
+
+// a device switched while a session runs.  the new device is started
+//   alongside the old one and takes its place at the first buffer through
+//   the probed pad, so that nothing else has to stop.  sources take over
+//   once they have something to give, sinks between two buffers from the
+//   receiving side.
+class DeviceSwap {
+public:
+    void *app = nullptr; // for callbacks
+
+    // the new device took over.  the old one can only be stopped from
+    //   outside its streaming thread, so this is called from a timer on
+    //   mainContext.  finish() the swap from here.
+    void (*cb_switched)(DeviceSwap *swap, void *app) = nullptr;
+
+    // from is the device in use, it stays with the caller until finish()
+    DeviceSwap(PDevice::Type type, PipelineDeviceContext *from, GMainContext *mainContext);
+
+    PDevice::Type type() const;
+
+    // start the device id in pipeline, to switch to.  returns false if it
+    //   can't be, the swap still has to be finished then.
+    bool start(PipelineContext *pipeline, const QString &id, const PipelineDeviceOptions &opts);
+
+    // stop switching, and delete the swap.  the device that isn't in use
+    //   after all, the old one or the new one, is deleted too.  returns the
+    //   one that is.
+    PipelineDeviceContext *finish();
+
+private:
+    PDevice::Type          type_;
+    PipelineDeviceContext *from_;
+    PipelineDeviceContext *to_ = nullptr;
+    GMainContext *         mainContext_;
+    GstPad *               oldPad = nullptr; // of the devices, src or sink
+    GstPad *               newPad = nullptr;
+    GstPad *               pad    = nullptr; // probed
+    QMutex                 m;
+    gulong                 probe    = 0;
+    bool                   switched = false;
+    GSource *              timer    = nullptr;
+    QAtomicInt             refs     = 1; // ours, and the probe's while it is installed
+
+    ~DeviceSwap();
+
+    static GstPadProbeReturn cb_swap_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+    static void              cb_swap_probe_removed(gpointer data);
+    static GstPadProbeReturn cb_drop_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+    static gboolean          cb_switched_timeout(gpointer data);
+
+    GstPadProbeReturn swap_probe();
+    gboolean          switched_timeout();
+    void              release();
+};
+
+}
+
+#endif
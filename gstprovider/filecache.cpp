@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+#include "filecache.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QMutex>
+
+// total size of the cache in megabytes, 0 turns it off
+#define DEFAULT_FILE_CACHE_MB 64
+
+namespace PsiMedia {
+
+static qint64 get_file_cache_bytes()
+{
+    QString val = QString::fromLatin1(qgetenv("PSI_FILE_CACHE_MB"));
+    int     mb  = val.isEmpty() ? DEFAULT_FILE_CACHE_MB : qMax(val.toInt(), 0);
+    return qint64(mb) * 1024 * 1024;
+}
+
+// most recently used last
+static QMutex                                      cache_mutex;
+static QList<QSharedPointer<const FileCacheEntry>> cache;
+
+QString FileCache::fileKey(const QString &fileName, const QByteArray &fileData)
+{
+    if (get_file_cache_bytes() == 0)
+        return QString();
+
+    if (!fileName.isEmpty()) {
+        QFileInfo fi(fileName);
+        if (!fi.exists())
+            return QString();
+        return QString("file:%1:%2:%3")
+            .arg(fi.canonicalFilePath())
+            .arg(fi.lastModified().toMSecsSinceEpoch())
+            .arg(fi.size());
+    } else
+        return "data:" + QString::fromLatin1(QCryptographicHash::hash(fileData, QCryptographicHash::Sha1).toHex());
+}
+
+// a single file shouldn't push out everything else
+qint64 FileCache::maxEntryBytes() { return get_file_cache_bytes() / 4; }
+
+QSharedPointer<const FileCacheEntry> FileCache::find(const QString &key)
+{
+    QMutexLocker locker(&cache_mutex);
+    for (int n = 0; n < cache.count(); ++n) {
+        if (cache[n]->key == key) {
+            QSharedPointer<const FileCacheEntry> entry = cache.takeAt(n);
+            cache += entry;
+            return entry;
+        }
+    }
+    return QSharedPointer<const FileCacheEntry>();
+}
+
+void FileCache::insert(const QSharedPointer<const FileCacheEntry> &entry)
+{
+    qint64 maxBytes = get_file_cache_bytes();
+
+    QMutexLocker locker(&cache_mutex);
+    qint64       total = entry->bytes;
+    for (int n = cache.count() - 1; n >= 0; --n) {
+        // a session played it meanwhile, keep the older copy
+        if (cache[n]->key == entry->key)
+            return;
+        total += cache[n]->bytes;
+    }
+
+    // sessions replaying an evicted entry hold on to it until done
+    while (!cache.isEmpty() && total > maxBytes)
+        total -= cache.takeFirst()->bytes;
+
+    cache += entry;
+}
+
+}
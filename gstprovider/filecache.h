@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+#ifndef PSI_FILECACHE_H
+#define PSI_FILECACHE_H
+
+#include "psimediaprovider.h"
+#include <QByteArray>
+#include <QList>
+#include <QSharedPointer>
+#include <QString>
+
+namespace PsiMedia {
+
+// the rtp a file session sent, with when it was sent.  once complete it is
+//   never changed, so any number of sessions can replay it at once.
+class FileCacheEntry {
+public:
+    class Packet {
+    public:
+        qint64     timeUs; // since the first packet
+        bool       video;
+        QByteArray data;
+    };
+
+    QString             key;
+    QList<PPayloadInfo> audioPayloadInfo;
+    QList<PPayloadInfo> videoPayloadInfo;
+    QList<Packet>       packets;
+    qint64              bytes = 0;
+};
+
+// process-wide cache of encoded files, so that playing the same prompt to
+//   many sessions costs a memory read instead of a decode and encode each.
+//   the least recently used entries go when the size limit is reached.
+class FileCache {
+public:
+    // identifies the file: name, modification time and size, or a hash of
+    //   the contents for in-memory files.  empty if caching is disabled.
+    static QString fileKey(const QString &fileName, const QByteArray &fileData);
+
+    // largest size a single entry may reach while recording
+    static qint64 maxEntryBytes();
+
+    static QSharedPointer<const FileCacheEntry> find(const QString &key);
+    static void                                 insert(const QSharedPointer<const FileCacheEntry> &entry);
+};
+
+}
+
+#endif
@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+
+#include "fileloop.h"
+
+// event marking the end of a pass
+#define FILE_PASS_END "psimedia-file-pass-end"
+
+namespace PsiMedia {
+
+FileLoop::FileLoop(GstElement *demux, GMainContext *mainContext) : demux_(demux), mainContext_(mainContext) { }
+
+FileLoop::~FileLoop()
+{
+    if (timer) {
+        g_source_destroy(timer);
+        g_source_unref(timer);
+    }
+}
+
+void FileLoop::addStream(GstPad *pad)
+{
+    m.lock();
+    ++streams;
+    m.unlock();
+
+    gst_pad_add_probe(pad, GstPadProbeType(GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM),
+                      cb_demux_probe, this, nullptr);
+}
+
+void FileLoop::watchPass(GstElement *rtpsink)
+{
+    GstPad *pad = gst_element_get_static_pad(rtpsink, "sink");
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, cb_pass_probe, this, nullptr);
+    gst_object_unref(pad);
+}
+
+// it goes to the demuxer only, as the pipeline may be shared
+void FileLoop::start()
+{
+    gst_element_send_event(demux_,
+                           gst_event_new_seek(1.0, GST_FORMAT_TIME,
+                                              GstSeekFlags(GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_SEGMENT),
+                                              GST_SEEK_TYPE_SET, 0, GST_SEEK_TYPE_END, 0));
+}
+
+GstPadProbeReturn FileLoop::cb_demux_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+    return static_cast<FileLoop *>(data)->demux_probe(pad, info);
+}
+
+GstPadProbeReturn FileLoop::cb_pass_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+    Q_UNUSED(pad)
+    return static_cast<FileLoop *>(data)->pass_probe(info);
+}
+
+gboolean FileLoop::cb_loop(gpointer data) { return static_cast<FileLoop *>(data)->loop(); }
+
+GstPadProbeReturn FileLoop::demux_probe(GstPad *pad, GstPadProbeInfo *info)
+{
+    if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+        GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER(info);
+
+        QMutexLocker locker(&m);
+        if (GST_BUFFER_PTS_IS_VALID(buf)) {
+            GstClockTime bufEnd = GST_BUFFER_PTS(buf);
+            if (GST_BUFFER_DURATION_IS_VALID(buf))
+                bufEnd += GST_BUFFER_DURATION(buf);
+            end = qMax(end, bufEnd);
+        }
+
+        if (offset == 0)
+            return GST_PAD_PROBE_OK;
+
+        // the stream headers were sent with the first pass
+        if (GST_BUFFER_FLAG_IS_SET(buf, GST_BUFFER_FLAG_HEADER))
+            return GST_PAD_PROBE_DROP;
+
+        buf = gst_buffer_make_writable(buf);
+        if (GST_BUFFER_PTS_IS_VALID(buf))
+            GST_BUFFER_PTS(buf) += offset;
+        if (GST_BUFFER_DTS_IS_VALID(buf))
+            GST_BUFFER_DTS(buf) += offset;
+        GST_PAD_PROBE_INFO_DATA(info) = buf;
+        return GST_PAD_PROBE_OK;
+    }
+
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT(info);
+    switch (GST_EVENT_TYPE(event)) {
+    case GST_EVENT_FLUSH_STOP:
+        // after a flush, downstream needs a segment again
+        g_object_set_data(G_OBJECT(pad), "psimedia-segment", nullptr);
+        return GST_PAD_PROBE_OK;
+
+    case GST_EVENT_SEGMENT: {
+        if (g_object_get_data(G_OBJECT(pad), "psimedia-segment"))
+            return GST_PAD_PROBE_DROP;
+        g_object_set_data(G_OBJECT(pad), "psimedia-segment", GINT_TO_POINTER(1));
+
+        // open ended, or the later passes would be clipped
+        const GstSegment *segment;
+        gst_event_parse_segment(event, &segment);
+        GstSegment open = *segment;
+        open.stop       = GST_CLOCK_TIME_NONE;
+        gst_event_unref(event);
+        GST_PAD_PROBE_INFO_DATA(info) = gst_event_new_segment(&open);
+        return GST_PAD_PROBE_OK;
+    }
+
+    case GST_EVENT_SEGMENT_DONE: {
+        // start over once every stream is through
+        QMutexLocker locker(&m);
+        if (++loopsDone >= streams && !timer) {
+            loopsDone = 0;
+            offset += end;
+            end = 0;
+
+            timer = g_timeout_source_new(0);
+            g_source_set_callback(timer, cb_loop, this, nullptr);
+            g_source_attach(timer, mainContext_);
+        }
+
+        // the queues still hold the end of this pass.  mark where it is,
+        //   so that we can tell once it was actually sent, see pass_probe()
+        gst_event_unref(event);
+        GST_PAD_PROBE_INFO_DATA(info)
+            = gst_event_new_custom(GST_EVENT_CUSTOM_DOWNSTREAM, gst_structure_new_empty(FILE_PASS_END));
+        return GST_PAD_PROBE_OK;
+    }
+
+    default:
+        return GST_PAD_PROBE_OK;
+    }
+}
+
+// the end of a pass made it to the rtp appsink of a stream, everything
+//   before it was sent
+GstPadProbeReturn FileLoop::pass_probe(GstPadProbeInfo *info)
+{
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT(info);
+    if (GST_EVENT_TYPE(event) != GST_EVENT_CUSTOM_DOWNSTREAM || !gst_event_has_name(event, FILE_PASS_END))
+        return GST_PAD_PROBE_OK;
+
+    m.lock();
+    bool sent = ++passesSent == streams;
+    m.unlock();
+
+    if (sent && cb_firstPassSent)
+        cb_firstPassSent(app);
+
+    // only the first pass is of interest
+    return GST_PAD_PROBE_REMOVE;
+}
+
+gboolean FileLoop::loop()
+{
+    m.lock();
+    g_source_unref(timer);
+    timer = nullptr;
+    m.unlock();
+
+    gst_element_send_event(demux_,
+                           gst_event_new_seek(1.0, GST_FORMAT_TIME, GST_SEEK_FLAG_SEGMENT, GST_SEEK_TYPE_SET, 0,
+                                              GST_SEEK_TYPE_END, 0));
+    return FALSE;
+}
+
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+
+#ifndef PSI_FILELOOP_H
+#define PSI_FILELOOP_H
+
+#include <QMutex>
+#include <gst/gst.h>
+
+namespace PsiMedia {
+
+// gapless looping of a file input.  each pass is a non-flushing segment
+//   seek on the demuxer, so the decoders, encoders and payloaders keep
+//   running.  downstream sees a single segment: later passes have their
+//   timestamps moved on by the length of those before, and their segments
+//   are dropped.  the passes are started from a timer on mainContext.
+class FileLoop {
+public:
+    void *app = nullptr; // for callbacks
+
+    // every stream is through the first pass, as far as the sinks given to
+    //   watchPass().  called from a streaming thread.
+    void (*cb_firstPassSent)(void *app) = nullptr;
+
+    FileLoop(GstElement *demux, GMainContext *mainContext);
+    ~FileLoop();
+
+    // a demuxer pad a stream is sent from
+    void addStream(GstPad *pad);
+
+    // watch for the end of the first pass at the rtp appsink of a stream
+    void watchPass(GstElement *rtpsink);
+
+    // the first pass, once the pipeline is prerolled.  the demuxer ends it
+    //   with segment-done rather than eos, so it can be started over
+    //   without flushing anything.
+    void start();
+
+private:
+    GstElement *  demux_;
+    GMainContext *mainContext_;
+    QMutex        m;
+    int           streams    = 0;
+    int           loopsDone  = 0; // streams through this pass
+    GstClockTime  offset     = 0; // added to the timestamps
+    GstClockTime  end        = 0; // of this pass
+    GSource *     timer      = nullptr;
+    int           passesSent = 0; // streams whose first pass reached the sink
+
+    static GstPadProbeReturn cb_demux_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+    static GstPadProbeReturn cb_pass_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+    static gboolean          cb_loop(gpointer data);
+
+    GstPadProbeReturn demux_probe(GstPad *pad, GstPadProbeInfo *info);
+    GstPadProbeReturn pass_probe(GstPadProbeInfo *info);
+    gboolean          loop();
+};
+
+}
+
+#endif
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+
+#include "filereplay.h"
+
+// cached files are replayed with this resolution (ms)
+#define FILE_REPLAY_INTERVAL 10
+
+namespace PsiMedia {
+
+FileReplay::FileReplay(const QSharedPointer<const FileCacheEntry> &entry, bool loop, GMainContext *mainContext) :
+    entry_(entry), loop_(loop), mainContext_(mainContext)
+{
+}
+
+FileReplay::~FileReplay()
+{
+    if (timer) {
+        g_source_destroy(timer);
+        g_source_unref(timer);
+    }
+}
+
+void FileReplay::start()
+{
+    Q_ASSERT(!timer);
+
+    at = 0;
+    clock.start();
+    timer = g_timeout_source_new(FILE_REPLAY_INTERVAL);
+    g_source_set_callback(timer, cb_tick, this, nullptr);
+    g_source_attach(timer, mainContext_);
+}
+
+gboolean FileReplay::cb_tick(gpointer data) { return static_cast<FileReplay *>(data)->tick(); }
+
+gboolean FileReplay::tick()
+{
+    const QList<FileCacheEntry::Packet> &packets = entry_->packets;
+
+    qint64 now = clock.nsecsElapsed() / 1000;
+    for (; at < packets.count() && packets[at].timeUs <= now; ++at) {
+        PRtpPacket packet;
+        packet.rawValue   = packets[at].data;
+        packet.portOffset = 0;
+        if (cb_packet)
+            cb_packet(packet, packets[at].video, app);
+    }
+
+    if (at < packets.count())
+        return TRUE;
+
+    if (loop_) {
+        at = 0;
+        clock.start();
+        if (cb_looped)
+            cb_looped(app);
+        return TRUE;
+    }
+
+    // the callback may delete us
+    g_source_unref(timer);
+    timer = nullptr;
+
+    if (cb_finished)
+        cb_finished(app);
+    return FALSE;
+}
+
+}
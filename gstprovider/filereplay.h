@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+
+#ifndef PSI_FILEREPLAY_H
+#define PSI_FILEREPLAY_H
+
+#include "filecache.h"
+#include "psimediaprovider.h"
+#include <QElapsedTimer>
+#include <QSharedPointer>
+#include <gst/gst.h>
+
+namespace PsiMedia {
+
+// sends a file from the cache in place of playing it: the packets it was
+//   sent with before, at the same pace.  the packets are someone else's, so
+//   they have to be sent through a SharedStream.  runs from a timer on
+//   mainContext.
+class FileReplay {
+public:
+    void *app = nullptr; // for callbacks
+
+    // a packet is due
+    void (*cb_packet)(const PRtpPacket &packet, bool video, void *app) = nullptr;
+
+    // looping, the packets start over from the first one
+    void (*cb_looped)(void *app) = nullptr;
+
+    // all packets were sent, if not looping
+    void (*cb_finished)(void *app) = nullptr;
+
+    FileReplay(const QSharedPointer<const FileCacheEntry> &entry, bool loop, GMainContext *mainContext);
+    ~FileReplay();
+
+    void start();
+
+private:
+    QSharedPointer<const FileCacheEntry> entry_;
+    bool                                 loop_;
+    GMainContext *                       mainContext_;
+    GSource *                            timer = nullptr;
+    int                                  at    = 0; // next packet
+    QElapsedTimer                        clock;     // since the first packet
+
+    static gboolean cb_tick(gpointer data);
+
+    gboolean tick();
+};
+
+}
+
+#endif
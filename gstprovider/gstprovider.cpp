@@ -23,21 +23,30 @@
 #include "devices.h"
 #include "gstthread.h"
 #include "modes.h"
+#include "rtprelay.h"
 #include "rwcontrol.h"
+#include <QFileDevice>
 #include <QIODevice>
 #include <QImage>
 #include <QMutex>
+#include <QPointer>
 #include <QStringList>
+#include <QThread>
 #include <QTime>
 #include <QWaitCondition>
 #include <QtPlugin>
 
 #ifdef QT_GUI_LIB
 #include <QPainter>
-#include <QThread>
 #include <QWidget>
 #endif
 
+// recorded data waiting to be written beyond this holds up the recording
+#define RECORD_BUFFER_MAX (4 * 1024 * 1024)
+
+// how often a recording held up that way checks whether to give up (ms)
+#define RECORD_WAIT_INTERVAL 100
+
 namespace PsiMedia {
 
 static PDevice gstDeviceToPDevice(const GstDevice &dev, PDevice::Type type)
@@ -50,6 +59,19 @@ static PDevice gstDeviceToPDevice(const GstDevice &dev, PDevice::Type type)
     return out;
 }
 
+static PNetworkStats exportNetworkStats(const RtpWorker::NetworkStats &s)
+{
+    PNetworkStats out;
+    out.roundTripMs   = s.roundTripMs;
+    out.sendLoss      = s.sendLoss;
+    out.sendJitterMs  = s.sendJitterMs;
+    out.recvJitterMs  = s.recvJitterMs;
+    out.recvLost      = s.recvLost;
+    out.recvLatencyMs = s.recvLatencyMs;
+    out.recvLateRate  = s.recvLateRate;
+    return out;
+}
+
 //----------------------------------------------------------------------------
 // GstVideoWidget
 //----------------------------------------------------------------------------
@@ -77,8 +99,13 @@ public:
         context->qwidget()->update();
     }
 
+signals:
+    // the session feeds this back to the pipeline, so that frames arrive
+    //   already scaled to what we display
+    void resized(const QSize &newSize);
+
 private slots:
-    void context_resized(const QSize &newSize) { Q_UNUSED(newSize); }
+    void context_resized(const QSize &newSize) { emit resized(newSize); }
 
     void context_paintEvent(QPainter *p)
     {
@@ -95,8 +122,9 @@ private slots:
         else if (newSize.height() < size.height())
             yoff = (size.height() - newSize.height()) / 2;
 
-        // ideally, the backend will follow desired_size() and give
-        //   us images that generally don't need resizing
+        // the pipeline only ever scales down to the widget size, so this
+        //   is hit for every frame when the widget is larger than the
+        //   video, and otherwise only until a resize has made it through
         QImage i;
         if (curImage.size() != newSize) {
             // the IgnoreAspectRatio is okay here, since we
@@ -198,6 +226,9 @@ signals:
 // don't wake the main thread more often than this, for performance reasons
 #define WAKE_PACKET_MIN 40
 
+// how often to send sender reports for a relayed stream (ms)
+#define RELAY_REPORT_INTERVAL 5000
+
 class GstRtpSessionContext;
 
 class GstRtpChannel : public QObject, public RtpChannelContext {
@@ -216,7 +247,21 @@ public:
 
     int written_pending;
 
-    GstRtpChannel() : QObject(), enabled(false), wake_pending(false), written_pending(0) {}
+    // packets relayed to us from other sessions.  only one source feeds
+    //   the channel at a time, whatever the others send is dropped.
+    QMutex         relay_m;
+    RtpRewriter    relay;
+    GstRtpChannel *relaySource;
+    bool           relaySwitched;  // the current source hasn't been heard yet
+    bool           relayKeyFrames; // ask each new source for a key frame
+    QByteArray     relayCname;
+    QElapsedTimer  relayReported;
+
+    GstRtpChannel() :
+        QObject(), enabled(false), wake_pending(false), written_pending(0), relaySource(nullptr),
+        relaySwitched(false), relayKeyFrames(false)
+    {
+    }
 
     virtual QObject *qobject() { return this; }
 
@@ -266,6 +311,89 @@ public:
         }
     }
 
+    // make source the one that feeds this channel
+    void setRelaySource(GstRtpChannel *source)
+    {
+        QMutexLocker locker(&relay_m);
+        if (relaySource == source)
+            return;
+
+        relaySource   = source;
+        relaySwitched = true;
+    }
+
+    // stop taking packets from source, if it is the current one
+    void unsetRelaySource(GstRtpChannel *source)
+    {
+        QMutexLocker locker(&relay_m);
+        if (relaySource == source)
+            relaySource = nullptr;
+    }
+
+    // another session calls this, which may be in another thread.  rtcp
+    //   is not relayed, each peer gets sender reports from us instead.
+    void push_packet_for_relay(GstRtpChannel *from, const PRtpPacket &rtp, const QHash<int, int> &ptMap)
+    {
+        if (rtp.portOffset != 0)
+            return;
+
+        PRtpPacket out = rtp;
+        PRtpPacket report;
+        PRtpPacket keyFrameRequest;
+        {
+            QMutexLocker locker(&relay_m);
+            if (from != relaySource)
+                return;
+
+            // the peer can't decode the new stream before a key frame, so
+            //   ask the sender for one rather than wait for it
+            if (relaySwitched) {
+                relaySwitched = false;
+                qint64 ssrc   = rtp_packet_ssrc(rtp.rawValue);
+                if (relayKeyFrames && ssrc != -1) {
+                    keyFrameRequest.rawValue   = rtcp_key_frame_request(relay.ssrc(), quint32(ssrc));
+                    keyFrameRequest.portOffset = 1;
+                }
+            }
+
+            if (!relay.rewrite(&out.rawValue, ptMap))
+                return;
+
+            if (!relayReported.isValid() || relayReported.elapsed() >= RELAY_REPORT_INTERVAL) {
+                report.rawValue   = relay.senderReport(relayCname);
+                report.portOffset = 1;
+                relayReported.start();
+            }
+        }
+
+        push_packet_for_read(out);
+        if (!report.rawValue.isEmpty())
+            push_packet_for_read(report);
+
+        // goes back to where the packet came from
+        if (!keyFrameRequest.rawValue.isEmpty())
+            from->push_packet_for_read(keyFrameRequest);
+    }
+
+    // our peer lost the picture of what we relay to it.  it can only ask
+    //   us, so pass the request on to whoever sends the stream.  the source
+    //   is used under the lock, so it can't go away meanwhile.
+    void relay_key_frame_request(const PRtpPacket &rtcp)
+    {
+        if (!relayKeyFrames || !rtcp_is_key_frame_request(rtcp.rawValue))
+            return;
+
+        QMutexLocker locker(&relay_m);
+        qint64       ssrc = relay.sourceSsrc();
+        if (!relaySource || ssrc == -1)
+            return;
+
+        PRtpPacket request;
+        request.rawValue   = rtcp_key_frame_request(relay.ssrc(), quint32(ssrc));
+        request.portOffset = 1;
+        relaySource->push_packet_for_read(request);
+    }
+
 signals:
     void readyRead();
     void packetsWritten(int count);
@@ -296,6 +424,176 @@ private:
     void receiver_push_packet_for_write(const PRtpPacket &rtp);
 };
 
+//----------------------------------------------------------------------------
+// GstRecordDeviceProxy
+//----------------------------------------------------------------------------
+// most devices (sockets, processes) may only be used from the thread they
+//   belong to.  this one lives there, and the writer hands it the data
+//   through queued calls.  it deletes itself once the device is closed.
+class GstRecordDeviceProxy : public QObject {
+    Q_OBJECT
+
+public:
+    QMutex         m;
+    QWaitCondition cond;       // on queued going down
+    int            queued = 0; // handed over but not written yet
+
+    GstRecordDeviceProxy(QIODevice *dev) : device(dev) { moveToThread(dev->thread()); }
+
+signals:
+    void closed();
+
+public slots:
+    void write(const QByteArray &buf)
+    {
+        if (device)
+            device->write(buf);
+
+        QMutexLocker locker(&m);
+        queued -= buf.size();
+        cond.wakeAll();
+    }
+
+    void close()
+    {
+        if (device)
+            device->close();
+        emit closed();
+        deleteLater();
+    }
+
+private:
+    QPointer<QIODevice> device;
+};
+
+//----------------------------------------------------------------------------
+// GstRecordWriter
+//----------------------------------------------------------------------------
+// writes the recording to its device from a thread of its own, so slow
+//   storage never holds up the qt thread.  once RECORD_BUFFER_MAX bytes are
+//   waiting, push() blocks until some are written.  that holds up only the
+//   recording pipeline, which then drops packets rather than the call
+//   waiting for the disk.  only files are written from this thread, other
+//   devices get the data in their own, see GstRecordDeviceProxy.
+class GstRecordWriter : public QThread {
+    Q_OBJECT
+
+public:
+    GstRecordWriter(QObject *parent = nullptr) : QThread(parent) { }
+
+    // what was pushed is still written out, and the device closed.  a
+    //   device of another thread can't be waited for, as that may be the
+    //   one waiting here, so its data is just handed over.
+    ~GstRecordWriter()
+    {
+        m.lock();
+        quit = true;
+        cond.wakeAll();
+        m.unlock();
+        wait();
+    }
+
+    void setDevice(QIODevice *dev)
+    {
+        QMutexLocker locker(&m);
+        device = dev;
+        if (!qobject_cast<QFileDevice *>(dev)) {
+            proxy = new GstRecordDeviceProxy(dev);
+            connect(proxy, SIGNAL(closed()), SIGNAL(deviceClosed()));
+        }
+        if (!isRunning())
+            start();
+    }
+
+    // may be called from any thread.  an empty buf closes the device.
+    void push(const QByteArray &buf)
+    {
+        QMutexLocker locker(&m);
+        while (!buf.isEmpty() && pendingBytes >= RECORD_BUFFER_MAX && !quit)
+            cond.wait(&m);
+        pending += buf;
+        pendingBytes += buf.size();
+        cond.wakeAll();
+    }
+
+signals:
+    void deviceClosed();
+
+protected:
+    void run()
+    {
+        QMutexLocker locker(&m);
+        while (!quit || !pending.isEmpty()) {
+            if (pending.isEmpty()) {
+                cond.wait(&m);
+                continue;
+            }
+
+            QByteArray buf = pending.takeFirst();
+            pendingBytes -= buf.size();
+            cond.wakeAll();
+            QIODevice *           dev = device;
+            GstRecordDeviceProxy *p   = proxy;
+            locker.unlock();
+
+            if (p)
+                handOver(p, buf);
+            else if (!buf.isEmpty())
+                dev->write(buf);
+            else
+                dev->close();
+
+            locker.relock();
+            if (buf.isEmpty()) {
+                device = nullptr;
+                proxy  = nullptr; // gone once it closed the device
+
+                // the proxy says so itself once it is done
+                if (!quit && !p)
+                    emit deviceClosed();
+            }
+        }
+
+        // quitting in the middle of a recording
+        if (proxy) {
+            QMetaObject::invokeMethod(proxy, "close", Qt::QueuedConnection);
+            proxy = nullptr;
+        } else if (device)
+            device->close();
+        device = nullptr;
+    }
+
+private:
+    QMutex                m;
+    QWaitCondition        cond; // on any change
+    QIODevice *           device = nullptr;
+    GstRecordDeviceProxy *proxy  = nullptr;
+    QList<QByteArray>     pending;
+    int                   pendingBytes = 0;
+    bool                  quit         = false;
+
+    bool quitting()
+    {
+        QMutexLocker locker(&m);
+        return quit;
+    }
+
+    // the same limit applies to what the device's thread has yet to write
+    void handOver(GstRecordDeviceProxy *p, const QByteArray &buf)
+    {
+        p->m.lock();
+        while (!buf.isEmpty() && p->queued >= RECORD_BUFFER_MAX && !quitting())
+            p->cond.wait(&p->m, RECORD_WAIT_INTERVAL);
+        p->queued += buf.size();
+        p->m.unlock();
+
+        if (buf.isEmpty())
+            QMetaObject::invokeMethod(p, "close", Qt::QueuedConnection);
+        else
+            QMetaObject::invokeMethod(p, "write", Qt::QueuedConnection, Q_ARG(QByteArray, buf));
+    }
+};
+
 //----------------------------------------------------------------------------
 // GstRecorder
 //----------------------------------------------------------------------------
@@ -307,14 +605,13 @@ public:
     QIODevice *     recordDevice, *nextRecordDevice;
     bool            record_cancel;
 
-    QMutex            m;
-    bool              wake_pending;
-    QList<QByteArray> pending_in;
+    GstRecordWriter writer;
 
     GstRecorder(QObject *parent = nullptr) :
         QObject(parent), control(nullptr), recordDevice(nullptr), nextRecordDevice(nullptr), record_cancel(false),
-        wake_pending(false)
+        writer(this)
     {
+        connect(&writer, SIGNAL(deviceClosed()), SLOT(writer_deviceClosed()), Qt::QueuedConnection);
     }
 
     void setDevice(QIODevice *dev)
@@ -324,6 +621,7 @@ public:
 
         if (control) {
             recordDevice = dev;
+            writer.setDevice(dev);
 
             RwControlRecord record;
             record.enabled = true;
@@ -357,6 +655,7 @@ public:
         if (control && !recordDevice && nextRecordDevice) {
             recordDevice     = nextRecordDevice;
             nextRecordDevice = nullptr;
+            writer.setDevice(recordDevice);
 
             RwControlRecord record;
             record.enabled = true;
@@ -365,50 +664,21 @@ public:
     }
 
     // session calls this, which may be in another thread
-    void push_data_for_read(const QByteArray &buf)
-    {
-        QMutexLocker locker(&m);
-        pending_in += buf;
-        if (!wake_pending) {
-            wake_pending = true;
-            QMetaObject::invokeMethod(this, "processIn", Qt::QueuedConnection);
-        }
-    }
+    void push_data_for_read(const QByteArray &buf) { writer.push(buf); }
 
 signals:
     void stopped();
 
 private slots:
-    void processIn()
+    void writer_deviceClosed()
     {
-        m.lock();
-        wake_pending         = false;
-        QList<QByteArray> in = pending_in;
-        pending_in.clear();
-        m.unlock();
-
-        QPointer<QObject> self = this;
+        recordDevice = nullptr;
 
-        while (!in.isEmpty()) {
-            QByteArray buf = in.takeFirst();
+        bool wasCancelled = record_cancel;
+        record_cancel     = false;
 
-            if (!buf.isEmpty()) {
-                recordDevice->write(buf);
-            } else // EOF
-            {
-                recordDevice->close();
-                recordDevice = nullptr;
-
-                bool wasCancelled = record_cancel;
-                record_cancel     = false;
-
-                if (wasCancelled) {
-                    emit stopped();
-                    if (!self)
-                        return;
-                }
-            }
-        }
+        if (wasCancelled)
+            emit stopped();
     }
 };
 
@@ -443,6 +713,23 @@ public:
     QMutex        write_mutex;
     bool          allow_writes;
 
+    // forward-only relaying.  what is written to our channels also goes,
+    //   undecoded, to the channels of each target.  the lists are read from
+    //   the writing thread, so they are guarded.  no two sessions' mutexes
+    //   are ever held at once, as sessions may relay to each other.
+    class RelayTarget {
+    public:
+        GstRtpSessionContext *session;
+        bool                  audio;
+        bool                  video;
+        QHash<int, int>       audioPtMap;
+        QHash<int, int>       videoPtMap;
+    };
+
+    QMutex                        relay_mutex;
+    QList<RelayTarget>            relayTargets;
+    QList<GstRtpSessionContext *> relaySources;
+
     GstRtpSessionContext(GstMainLoop *_gstLoop, QObject *parent = nullptr) :
         QObject(parent), gstLoop(_gstLoop), control(nullptr), isStarted(false), isStopping(false),
         pending_status(false), recorder(this), allow_writes(false)
@@ -461,10 +748,33 @@ public:
         audioRtp.session = this;
         videoRtp.session = this;
 
+        audioRtp.relay.setClockRate(48000); // opus
+        videoRtp.relay.setClockRate(90000);
+
+        // one cname for both, so the peer can synchronize them
+        QByteArray cname        = "psimedia-relay-" + QByteArray::number(g_random_int(), 16);
+        audioRtp.relayCname     = cname;
+        videoRtp.relayCname     = cname;
+        videoRtp.relayKeyFrames = true;
+
         connect(&recorder, SIGNAL(stopped()), SLOT(recorder_stopped()));
     }
 
-    ~GstRtpSessionContext() { cleanup(); }
+    ~GstRtpSessionContext()
+    {
+        relay_mutex.lock();
+        QList<GstRtpSessionContext *> sources = relaySources;
+        QList<RelayTarget>            targets = relayTargets;
+        relayTargets.clear();
+        relay_mutex.unlock();
+
+        foreach (GstRtpSessionContext *source, sources)
+            source->removeRelayTarget(this);
+        foreach (const RelayTarget &t, targets)
+            unlinkRelayTarget(t.session);
+
+        cleanup();
+    }
 
     virtual QObject *qobject() { return this; }
 
@@ -476,6 +786,7 @@ public:
             previewWidget->show_frame(QImage());
 
         codecs = RwControlConfigCodecs();
+        relayCodecsChanged();
 
         isStarted      = false;
         isStopping     = false;
@@ -554,10 +865,13 @@ public:
         delete outputWidget;
         outputWidget = nullptr;
 
-        if (widget)
+        if (widget) {
             outputWidget = new GstVideoWidget(widget, this);
+            connect(outputWidget, SIGNAL(resized(const QSize &)), SLOT(outputWidget_resized(const QSize &)));
+        }
 
-        devices.useVideoOut = widget ? true : false;
+        devices.useVideoOut        = widget ? true : false;
+        devices.videoOutputMaxSize = widget ? widgetFrameSize(widget) : QSize();
         if (control)
             control->updateDevices(devices);
     }
@@ -573,10 +887,13 @@ public:
         delete previewWidget;
         previewWidget = nullptr;
 
-        if (widget)
+        if (widget) {
             previewWidget = new GstVideoWidget(widget, this);
+            connect(previewWidget, SIGNAL(resized(const QSize &)), SLOT(previewWidget_resized(const QSize &)));
+        }
 
-        devices.useVideoPreview = widget ? true : false;
+        devices.useVideoPreview     = widget ? true : false;
+        devices.videoPreviewMaxSize = widget ? widgetFrameSize(widget) : QSize();
         if (control)
             control->updateDevices(devices);
     }
@@ -610,12 +927,14 @@ public:
     {
         codecs.useRemoteAudioPayloadInfo = true;
         codecs.remoteAudioPayloadInfo    = info;
+        relayCodecsChanged();
     }
 
     virtual void setRemoteVideoPreferences(const QList<PPayloadInfo> &info)
     {
         codecs.useRemoteVideoPayloadInfo = true;
         codecs.remoteVideoPayloadInfo    = info;
+        relayCodecsChanged();
     }
 
     virtual void start()
@@ -729,13 +1048,131 @@ public:
 
     virtual Error errorCode() const { return static_cast<Error>(lastStatus.errorCode); }
 
+    virtual PNetworkStats audioNetworkStats() const
+    {
+        return control ? exportNetworkStats(control->audioNetworkStats()) : PNetworkStats();
+    }
+
+    virtual PNetworkStats videoNetworkStats() const
+    {
+        return control ? exportNetworkStats(control->videoNetworkStats()) : PNetworkStats();
+    }
+
     virtual RtpChannelContext *audioRtpChannel() { return &audioRtp; }
 
     virtual RtpChannelContext *videoRtpChannel() { return &videoRtp; }
 
+    virtual void addRelayTarget(RtpSessionContext *target, bool audio, bool video)
+    {
+        GstRtpSessionContext *session = qobject_cast<GstRtpSessionContext *>(target->qobject());
+        Q_ASSERT(session && session != this);
+
+        RelayTarget t;
+        t.session    = session;
+        t.audio      = audio;
+        t.video      = video;
+        t.audioPtMap = relay_payload_map(codecs.remoteAudioPayloadInfo, session->codecs.remoteAudioPayloadInfo);
+        t.videoPtMap = relay_payload_map(codecs.remoteVideoPayloadInfo, session->codecs.remoteVideoPayloadInfo);
+
+        relay_mutex.lock();
+        bool found = false;
+        for (int n = 0; n < relayTargets.count(); ++n) {
+            if (relayTargets[n].session == session) {
+                relayTargets[n] = t;
+                found           = true;
+                break;
+            }
+        }
+        if (!found)
+            relayTargets += t;
+        relay_mutex.unlock();
+
+        session->relay_mutex.lock();
+        if (!session->relaySources.contains(this))
+            session->relaySources += this;
+        session->relay_mutex.unlock();
+
+        // we are now the source for these, taking over from whoever was
+        if (audio)
+            session->audioRtp.setRelaySource(&audioRtp);
+        else
+            session->audioRtp.unsetRelaySource(&audioRtp);
+        if (video)
+            session->videoRtp.setRelaySource(&videoRtp);
+        else
+            session->videoRtp.unsetRelaySource(&videoRtp);
+    }
+
+    virtual void removeRelayTarget(RtpSessionContext *target)
+    {
+        GstRtpSessionContext *session = nullptr;
+
+        relay_mutex.lock();
+        for (int n = 0; n < relayTargets.count(); ++n) {
+            if (relayTargets[n].session->qobject() == target->qobject()) {
+                session = relayTargets[n].session;
+                relayTargets.removeAt(n);
+                break;
+            }
+        }
+        relay_mutex.unlock();
+
+        if (session)
+            unlinkRelayTarget(session);
+    }
+
+    // recompute the payload type maps of our targets from the codecs as
+    //   they are now
+    void updateRelayMaps()
+    {
+        QMutexLocker locker(&relay_mutex);
+        for (RelayTarget &t : relayTargets) {
+            t.audioPtMap = relay_payload_map(codecs.remoteAudioPayloadInfo, t.session->codecs.remoteAudioPayloadInfo);
+            t.videoPtMap = relay_payload_map(codecs.remoteVideoPayloadInfo, t.session->codecs.remoteVideoPayloadInfo);
+        }
+    }
+
+    // the maps depend on the codecs of both ends, so when ours change,
+    //   redo our own and those of whoever relays to us
+    void relayCodecsChanged()
+    {
+        updateRelayMaps();
+
+        relay_mutex.lock();
+        QList<GstRtpSessionContext *> sources = relaySources;
+        relay_mutex.unlock();
+
+        foreach (GstRtpSessionContext *source, sources)
+            source->updateRelayMaps();
+    }
+
+    // undo the target's side of a relay, once it is out of relayTargets
+    void unlinkRelayTarget(GstRtpSessionContext *session)
+    {
+        session->audioRtp.unsetRelaySource(&audioRtp);
+        session->videoRtp.unsetRelaySource(&videoRtp);
+
+        QMutexLocker locker(&session->relay_mutex);
+        session->relaySources.removeAll(this);
+    }
+
     // channel calls this, which may be in another thread
     void push_packet_for_write(GstRtpChannel *from, const PRtpPacket &rtp)
     {
+        if (rtp.portOffset == 1)
+            from->relay_key_frame_request(rtp);
+
+        // relaying works whether or not this session is started, so a
+        //   session can be used just for forwarding
+        relay_mutex.lock();
+        foreach (const RelayTarget &t, relayTargets) {
+            if (from == &audioRtp && t.audio)
+                t.session->audioRtp.push_packet_for_relay(&audioRtp, rtp, t.audioPtMap);
+            else if (from == &videoRtp && t.video)
+                t.session->videoRtp.push_packet_for_relay(&videoRtp, rtp, t.videoPtMap);
+        }
+        relay_mutex.unlock();
+
         QMutexLocker locker(&write_mutex);
         if (!allow_writes || !control)
             return;
@@ -815,7 +1252,36 @@ private slots:
 
     void recorder_stopped() { emit stoppedRecording(); }
 
+    void outputWidget_resized(const QSize &newSize)
+    {
+        QSize size = newSize.isEmpty() ? QSize() : newSize;
+        if (devices.videoOutputMaxSize == size)
+            return;
+        devices.videoOutputMaxSize = size;
+        if (control)
+            control->updateDevices(devices);
+    }
+
+    void previewWidget_resized(const QSize &newSize)
+    {
+        QSize size = newSize.isEmpty() ? QSize() : newSize;
+        if (devices.videoPreviewMaxSize == size)
+            return;
+        devices.videoPreviewMaxSize = size;
+        if (control)
+            control->updateDevices(devices);
+    }
+
 private:
+#ifdef QT_GUI_LIB
+    // not shown yet means no limit, we'll hear about the size later
+    static QSize widgetFrameSize(VideoWidgetContext *widget)
+    {
+        QSize size = widget->qwidget()->size();
+        return size.isEmpty() ? QSize() : size;
+    }
+#endif
+
     static void cb_control_rtpAudioOut(const PRtpPacket &packet, void *app)
     {
         static_cast<GstRtpSessionContext *>(app)->control_rtpAudioOut(packet);
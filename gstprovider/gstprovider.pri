@@ -5,23 +5,45 @@ include(devices/deviceenum.pri)
 
 HEADERS += \
 	$$PWD/devices.h \
+	$$PWD/deviceswap.h \
 	$$PWD/modes.h \
+	$$PWD/audiomixer.h \
 	$$PWD/payloadinfo.h \
 	$$PWD/pipeline.h \
 	$$PWD/bins.h \
+	$$PWD/bitratecontroller.h \
+	$$PWD/callrecorder.h \
+	$$PWD/filecache.h \
+	$$PWD/fileloop.h \
+	$$PWD/filereplay.h \
 	$$PWD/rtpworker.h \
 	$$PWD/gstthread.h \
-	$$PWD/rwcontrol.h
+	$$PWD/latencycontroller.h \
+	$$PWD/memorysource.h \
+	$$PWD/rtprelay.h \
+	$$PWD/rwcontrol.h \
+	$$PWD/sendshare.h
 
 SOURCES += \
 	$$PWD/devices.cpp \
+	$$PWD/deviceswap.cpp \
 	$$PWD/modes.cpp \
+	$$PWD/audiomixer.cpp \
 	$$PWD/payloadinfo.cpp \
 	$$PWD/pipeline.cpp \
 	$$PWD/bins.cpp \
+	$$PWD/bitratecontroller.cpp \
+	$$PWD/callrecorder.cpp \
+	$$PWD/filecache.cpp \
+	$$PWD/fileloop.cpp \
+	$$PWD/filereplay.cpp \
 	$$PWD/rtpworker.cpp \
 	$$PWD/gstthread.cpp \
+	$$PWD/latencycontroller.cpp \
+	$$PWD/memorysource.cpp \
+	$$PWD/rtprelay.cpp \
 	$$PWD/rwcontrol.cpp \
+	$$PWD/sendshare.cpp \
 	$$PWD/gstprovider.cpp
 
 unix {
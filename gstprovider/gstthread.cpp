@@ -22,6 +22,7 @@
 
 #include <QCoreApplication>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QLibrary>
 #include <QMutex>
 #include <QQueue>
@@ -136,12 +137,17 @@ static int compare_gst_version(uint a1, uint a2, uint a3, uint b1, uint b2, uint
 
 class GstSession {
 public:
-    CArgs   args;
-    QString version;
-    bool    success;
+    CArgs       args;
+    QString     version;
+    bool        success;
+    QStringList elements; // required, to be loaded after startup
+    int         elementsLoaded = 0;
 
     GstSession(const QString &pluginPath = QString())
     {
+        QElapsedTimer phase;
+        phase.start();
+
         args.set(QCoreApplication::instance()->arguments());
 
         // ignore "system" plugins
@@ -156,6 +162,7 @@ public:
             success = false;
             return;
         }
+        qint64 initTime = phase.restart();
 
         guint major, minor, micro, nano;
         gst_version(&major, &minor, &micro, &nano);
@@ -229,20 +236,45 @@ public:
                 << "ksvideosrc";
 #endif
 
+        // only the registry is looked at here, which loads no plugins.
+        //   gstreamer keeps it cached on disk and rescans the plugins that
+        //   changed by itself.  the elements are loaded once we're up, see
+        //   loadNextElement().
+        GstRegistry *registry = gst_registry_get();
         foreach (const QString &name, reqelem) {
-            GstElement *e = gst_element_factory_make(name.toLatin1().data(), nullptr);
-            if (!e) {
-                qDebug("Unable to load element '%s'.\n", qPrintable(name));
+            GstPluginFeature *f = gst_registry_lookup_feature(registry, name.toLatin1().data());
+            if (!f || !GST_IS_ELEMENT_FACTORY(f)) {
+                if (f)
+                    gst_object_unref(f);
+                qDebug("Unable to find element '%s'.\n", qPrintable(name));
                 success = false;
                 return;
             }
-
-            g_object_unref(G_OBJECT(e));
+            gst_object_unref(f);
         }
+        elements = reqelem;
 
+        qDebug("GStreamer startup: init %lld ms, elements %lld ms\n", initTime, phase.elapsed());
         success = true;
     }
 
+    // load one more required element, false once all are.  a plugin can be
+    //   in the registry and still fail to load, we can only tell by trying.
+    bool loadNextElement()
+    {
+        if (elementsLoaded >= elements.count())
+            return false;
+
+        const QString &name = elements[elementsLoaded++];
+        GstElement *   e    = gst_element_factory_make(name.toLatin1().data(), nullptr);
+        if (!e)
+            qWarning("Unable to load element '%s'.", qPrintable(name));
+        else
+            g_object_unref(G_OBJECT(e));
+
+        return elementsLoaded < elements.count();
+    }
+
     ~GstSession()
     {
         // docs say to not bother with gst_deinit, but we'll do it
@@ -277,11 +309,29 @@ public:
     BridgeQueueSource *                                 bridgeSource;
     guint                                               bridgeId;
     QQueue<QPair<GstMainLoop::ContextCallback, void *>> bridgeQueue;
+    QElapsedTimer                                       loadTime;
 
     Private(GstMainLoop *q) : q(q), gstSession(nullptr), success(false), mainContext(nullptr), mainLoop(nullptr) {}
 
     static gboolean cb_loop_started(gpointer data) { return static_cast<Private *>(data)->loop_started(); }
 
+    static gboolean cb_load_elements(gpointer data) { return static_cast<Private *>(data)->load_elements(); }
+
+    // plugins are loaded one per pass when there is nothing else to do, so
+    //   the first call doesn't wait for them, and sessions starting
+    //   meanwhile don't wait for all of them
+    gboolean load_elements()
+    {
+        if (!loadTime.isValid())
+            loadTime.start();
+
+        if (gstSession && gstSession->loadNextElement())
+            return TRUE;
+
+        qDebug("GStreamer plugins loaded in %lld ms\n", loadTime.elapsed());
+        return FALSE;
+    }
+
     gboolean loop_started()
     {
         w.wakeOne();
@@ -438,6 +488,12 @@ void GstMainLoop::init()
     GSource *timer = g_timeout_source_new(0);
     g_source_attach(timer, d->mainContext);
     g_source_set_callback(timer, GstMainLoop::Private::cb_loop_started, d, nullptr);
+
+    GSource *idle = g_idle_source_new();
+    g_source_set_priority(idle, G_PRIORITY_LOW);
+    g_source_set_callback(idle, GstMainLoop::Private::cb_load_elements, d, nullptr);
+    g_source_attach(idle, d->mainContext);
+    g_source_unref(idle);
     d->m.unlock();
     emit initialized();
 }
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+#include "latencycontroller.h"
+
+#include <QString>
+
+// in milliseconds
+#define DEFAULT_MIN_LATENCY 40
+#define DEFAULT_MAX_LATENCY 1000
+
+// the buffer should cover this many times the jitter estimate, plus some
+//   room for packetization
+#define JITTER_MULTIPLIER 4
+#define JITTER_HEADROOM 20
+
+// more late packets than this grows the buffer
+#define LATE_RATE_HIGH 0.01
+#define GROW_FACTOR 1.25
+
+// shrink by at most this much per step, and only after this many updates
+//   in a row without late packets
+#define SHRINK_FACTOR 0.9
+#define SHRINK_AFTER 5
+
+// ignore differences smaller than this, every change costs a latency
+//   recalculation of the pipeline
+#define MIN_CHANGE 10
+
+namespace PsiMedia {
+
+static int get_env_ms(const char *name, int def)
+{
+    QString val = QString::fromLatin1(qgetenv(name));
+    if (!val.isEmpty()) {
+        int x = val.toInt();
+        if (x > 0)
+            return x;
+    }
+    return def;
+}
+
+LatencyController::LatencyController(int initialMs) :
+    lastPushed_(0), lastLate_(0), lateRate_(0), cleanUpdates_(0)
+{
+    minMs_     = get_env_ms("PSI_RTP_LATENCY_MIN", DEFAULT_MIN_LATENCY);
+    maxMs_     = qMax(minMs_, get_env_ms("PSI_RTP_LATENCY_MAX", DEFAULT_MAX_LATENCY));
+    latencyMs_ = qBound(minMs_, initialMs, maxMs_);
+}
+
+bool LatencyController::update(int jitterMs, quint64 pushed, quint64 late)
+{
+    quint64 newPushed = pushed >= lastPushed_ ? pushed - lastPushed_ : 0;
+    quint64 newLate   = late >= lastLate_ ? late - lastLate_ : 0;
+    lastPushed_       = pushed;
+    lastLate_         = late;
+    lateRate_         = newPushed > 0 ? double(newLate) / newPushed : 0;
+
+    if (!isAdaptive())
+        return false;
+
+    int target = latencyMs_;
+    if (lateRate_ > LATE_RATE_HIGH) {
+        // playing out too early, whatever the jitter estimate says
+        cleanUpdates_ = 0;
+        target        = qMax(int(latencyMs_ * GROW_FACTOR), latencyMs_ + MIN_CHANGE);
+    } else if (jitterMs >= 0) {
+        int wanted = jitterMs * JITTER_MULTIPLIER + JITTER_HEADROOM;
+        if (newLate > 0)
+            cleanUpdates_ = 0;
+        else
+            ++cleanUpdates_;
+
+        if (wanted > latencyMs_)
+            target = wanted;
+        else if (cleanUpdates_ >= SHRINK_AFTER)
+            target = qMax(wanted, int(latencyMs_ * SHRINK_FACTOR));
+    }
+
+    target = qBound(minMs_, target, maxMs_);
+    if (qAbs(target - latencyMs_) < MIN_CHANGE)
+        return false;
+
+    latencyMs_ = target;
+    return true;
+}
+
+}
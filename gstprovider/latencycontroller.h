@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+#ifndef PSI_LATENCYCONTROLLER_H
+#define PSI_LATENCYCONTROLLER_H
+
+#include <QtGlobal>
+
+namespace PsiMedia {
+
+// sizes a jitterbuffer from what the network actually does.  the buffer
+//   should hold a few times the measured interarrival jitter.  it grows
+//   right away when packets start arriving too late to be played, and
+//   shrinks only slowly, after a while without late packets.
+//
+// the range can be set with PSI_RTP_LATENCY_MIN and PSI_RTP_LATENCY_MAX (in
+//   milliseconds).  setting both to the same value turns adaptation off.
+class LatencyController {
+public:
+    LatencyController(int initialMs);
+
+    bool isAdaptive() const { return minMs_ < maxMs_; }
+
+    // feed the current jitter estimate (ms, -1 if unknown) and the
+    //   jitterbuffer's cumulative pushed/late packet counters.  returns true
+    //   if latencyMs() changed.
+    bool update(int jitterMs, quint64 pushed, quint64 late);
+
+    int latencyMs() const { return latencyMs_; }
+
+    // late packets per pushed packet over the last update
+    double lateRate() const { return lateRate_; }
+
+private:
+    int     minMs_;
+    int     maxMs_;
+    int     latencyMs_;
+    quint64 lastPushed_;
+    quint64 lastLate_;
+    double  lateRate_;
+    int     cleanUpdates_; // updates in a row without late packets
+};
+
+}
+
+#endif
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+
+#include "memorysource.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QWeakPointer>
+#include <climits>
+#include <gst/app/gstappsrc.h>
+
+// what a memory source hands out at a time, unless asked for something else
+#define MEMSRC_BLOCK_SIZE 4096
+
+// files up to this size are read into memory rather than mapped
+#define MAPPED_FILE_MIN (4 * 1024 * 1024)
+
+namespace PsiMedia {
+
+// a file mapped into memory, for all sessions playing it.  it is unmapped
+//   once the last buffer pointing into it is gone.  small files are copied
+//   instead, the mapping is only worth it for big ones.
+class MappedFile {
+public:
+    QString    key;
+    QFile      file;
+    QByteArray copy; // if small
+    uchar *    data = nullptr;
+    qint64     size = 0;
+
+    ~MappedFile();
+};
+
+// what the buffers keep alive
+class MemoryData {
+public:
+    QByteArray                 data;
+    QSharedPointer<MappedFile> mapping; // if data points into it
+};
+
+class MemorySource {
+public:
+    MemoryData mem;
+    QMutex     m;
+    int        offset = 0;
+};
+
+static void memsrc_release(gpointer data) { delete static_cast<MemoryData *>(data); }
+
+static void memsrc_need_data(GstAppSrc *appsrc, guint length, gpointer user_data)
+{
+    MemorySource *ms = static_cast<MemorySource *>(user_data);
+
+    QMutexLocker locker(&ms->m);
+    if (ms->offset >= ms->mem.data.size()) {
+        gst_app_src_end_of_stream(appsrc);
+        return;
+    }
+
+    // length is only a hint, and may be -1
+    int len = (length > 0 && length < guint(MEMSRC_BLOCK_SIZE) * 16) ? int(length) : MEMSRC_BLOCK_SIZE;
+    len     = qMin(len, ms->mem.data.size() - ms->offset);
+
+    MemoryData *ref    = new MemoryData(ms->mem); // shared, not copied
+    GstBuffer * buffer = gst_buffer_new_wrapped_full(
+        GST_MEMORY_FLAG_READONLY, const_cast<char *>(ref->data.constData()), gsize(ref->data.size()),
+        gsize(ms->offset), gsize(len), ref, memsrc_release);
+    GST_BUFFER_OFFSET(buffer) = guint64(ms->offset);
+    ms->offset += len;
+    locker.unlock();
+
+    gst_app_src_push_buffer(appsrc, buffer);
+}
+
+static gboolean memsrc_seek_data(GstAppSrc *appsrc, guint64 offset, gpointer user_data)
+{
+    Q_UNUSED(appsrc);
+    MemorySource *ms = static_cast<MemorySource *>(user_data);
+
+    QMutexLocker locker(&ms->m);
+    if (offset > guint64(ms->mem.data.size()))
+        return FALSE;
+    ms->offset = int(offset);
+    return TRUE;
+}
+
+static void memsrc_free(gpointer user_data) { delete static_cast<MemorySource *>(user_data); }
+
+static GstElement *make_source(const MemoryData &mem)
+{
+    GstElement *appsrc = gst_element_factory_make("appsrc", nullptr);
+    g_object_set(G_OBJECT(appsrc), "stream-type", GST_APP_STREAM_TYPE_RANDOM_ACCESS, "format", GST_FORMAT_BYTES,
+                 "size", gint64(mem.data.size()), nullptr);
+
+    MemorySource *ms = new MemorySource;
+    ms->mem          = mem;
+
+    GstAppSrcCallbacks srcCb = {};
+    srcCb.need_data          = memsrc_need_data;
+    srcCb.seek_data          = memsrc_seek_data;
+    gst_app_src_set_callbacks(reinterpret_cast<GstAppSrc *>(appsrc), &srcCb, ms, memsrc_free);
+    return appsrc;
+}
+
+GstElement *make_memory_source(const QByteArray &data)
+{
+    MemoryData mem;
+    mem.data = data;
+    return make_source(mem);
+}
+
+// mapped files by path, modification time and size, so a changed file gets
+//   a mapping of its own.  never drop a mapping with the lock held, its
+//   destructor takes it.
+static QMutex                                   mapped_files_mutex;
+static QHash<QString, QWeakPointer<MappedFile>> mapped_files;
+
+MappedFile::~MappedFile()
+{
+    // a new mapping of the file may have taken our place already
+    QMutexLocker locker(&mapped_files_mutex);
+    if (mapped_files.value(key).isNull())
+        mapped_files.remove(key);
+}
+
+GstElement *make_mapped_file_source(const QString &fileName)
+{
+    QFileInfo fi(fileName);
+    QString   key = QString("%1:%2:%3")
+                      .arg(fi.canonicalFilePath())
+                      .arg(fi.lastModified().toMSecsSinceEpoch())
+                      .arg(fi.size());
+
+    mapped_files_mutex.lock();
+    QSharedPointer<MappedFile> mapping = mapped_files.value(key).toStrongRef();
+    mapped_files_mutex.unlock();
+
+    if (!mapping) {
+        // byte arrays can't be any bigger
+        if (fi.size() <= 0 || fi.size() > INT_MAX)
+            return nullptr;
+
+        mapping      = QSharedPointer<MappedFile>::create();
+        mapping->key = key;
+        mapping->file.setFileName(fileName);
+        if (!mapping->file.open(QIODevice::ReadOnly))
+            return nullptr;
+        mapping->size = mapping->file.size();
+        if (mapping->size <= MAPPED_FILE_MIN) {
+            mapping->copy = mapping->file.readAll();
+            mapping->file.close();
+            if (mapping->copy.size() != mapping->size)
+                return nullptr;
+            mapping->data = reinterpret_cast<uchar *>(mapping->copy.data());
+        } else {
+            mapping->data = mapping->file.map(0, mapping->size);
+            if (!mapping->data)
+                return nullptr;
+        }
+
+        // another session may have mapped it meanwhile
+        QSharedPointer<MappedFile> other;
+        mapped_files_mutex.lock();
+        other = mapped_files.value(key).toStrongRef();
+        if (!other)
+            mapped_files.insert(key, mapping);
+        mapped_files_mutex.unlock();
+        if (other)
+            mapping = other;
+    }
+
+    MemoryData mem;
+    mem.data    = QByteArray::fromRawData(reinterpret_cast<const char *>(mapping->data), int(mapping->size));
+    mem.mapping = mapping;
+    return make_source(mem);
+}
+
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+
+#ifndef PSI_MEMORYSOURCE_H
+#define PSI_MEMORYSOURCE_H
+
+#include <QByteArray>
+#include <QString>
+#include <gst/gst.h>
+
+namespace PsiMedia {
+
+// in-memory file input, as an appsrc.  the buffers point straight into the
+//   byte array and keep a reference to it, so the data is never copied,
+//   however many sessions play the same one.  seeking is supported, for the
+//   demuxer and for looping.
+GstElement *make_memory_source(const QByteArray &data);
+
+// the file as a memory source, reading it through a mapping of it rather
+//   than copying it a block at a time.  one mapping is shared by all the
+//   sessions playing the file.  nullptr if it can't be read.
+//
+// a mapped file that gets truncated takes the process down with SIGBUS on
+//   the next read past the new end, there is no catching that.  so files
+//   played from must not be truncated or rewritten in place while in use,
+//   only replaced (a new file renamed over the old one is fine).
+GstElement *make_mapped_file_source(const QString &fileName);
+
+}
+
+#endif
@@ -84,15 +84,23 @@ QList<PAudioParams> modes_supportedAudio()
         p.channels   = 1;
         list += p;
     }
-    /*{
+    {
         PAudioParams p;
-        p.codec = "opus";
-        p.sampleRate = 32000;
+        p.codec      = "opus";
+        p.sampleRate = 24000;
         p.sampleSize = 16;
-        p.channels = 1;
+        p.channels   = 1;
         list += p;
     }
     {
+        PAudioParams p;
+        p.codec      = "opus";
+        p.sampleRate = 48000;
+        p.sampleSize = 16;
+        p.channels   = 1;
+        list += p;
+    }
+    /*{
         PAudioParams p;
         p.codec = "vorbis";
         p.sampleRate = 44100;
@@ -135,6 +143,13 @@ QList<PVideoParams> modes_supportedVideo()
         p.fps   = 30;
         list += p;
     }
+    {
+        PVideoParams p;
+        p.codec = "theora";
+        p.size  = QSize(320, 240);
+        p.fps   = 15;
+        list += p;
+    }
     /*{
         PVideoParams p;
         p.codec = "theora";
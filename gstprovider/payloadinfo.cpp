@@ -233,7 +233,10 @@ PPayloadInfo structureToPayloadInfo(GstStructure *structure, QString *media)
               << "width"
               << "height"
               << "delivery-method"
-              << "configuration";
+              << "configuration"
+              << "stereo"
+              << "sprop-stereo"
+              << "sprop-maxcapturerate";
 
     QList<PPayloadInfo::Parameter> list;
 
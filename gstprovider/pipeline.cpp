@@ -32,13 +32,17 @@
 
 #define PIPELINE_DEBUG
 
-// rates lower than 22050 (e.g. 16000) might not work with echo-cancel
-#define DEFAULT_FIXED_RATE 22050
+#define WEBRTCDSP_RATE 48000
+
+// output at the echo canceller's rate, which is also what opus decodes to,
+//   so that nothing on the way gets resampled
+#define DEFAULT_FIXED_RATE WEBRTCDSP_RATE
 
 // in milliseconds
 #define DEFAULT_LATENCY 20
 
-#define WEBRTCDSP_RATE 48000
+// threads for mjpeg decoding, 0 = auto
+#define DEFAULT_JPEG_THREADS 0
 
 //#define USE_LIVEADDER
 
@@ -57,6 +61,16 @@ static int get_fixed_rate()
         return DEFAULT_FIXED_RATE;
 }
 
+// 0 lets the decoder pick based on the number of cpus
+static int get_jpeg_threads()
+{
+    QString val = QString::fromLatin1(qgetenv("PSI_JPEG_THREADS"));
+    if (!val.isEmpty())
+        return qMax(val.toInt(), 0);
+    else
+        return DEFAULT_JPEG_THREADS;
+}
+
 static int get_latency_time()
 {
     QString val = QString::fromLatin1(qgetenv("PSI_AUDIO_LTIME"));
@@ -117,38 +131,192 @@ static GstCaps *filter_for_capture_size(const QSize &size)
                              nullptr);
 }
 
-static GstCaps *filter_for_desired_size(const QSize &size)
+// used when the device can't tell us its modes.  the caps are listed in order
+//   of preference, and negotiation picks the first one the device accepts:
+//   the wanted size as raw, then as jpeg, then whatever the device has (the
+//   prep bin will scale it afterwards).
+static GstCaps *filter_for_desired_size(const QSize &size, int fps)
 {
-    Q_UNUSED(size)
-    //	QList<int> widths;
-    //	widths << 160 << 320 << 640 << 800 << 1024;
-    //	for(int n = 0; n < widths.count(); ++n)
-    //	{
-    //		if(widths[n] < size.width())
-    //		{
-    //			widths.removeAt(n);
-    //			--n; // adjust position
-    //		}
-    //	}
-
-    //	GstElement *capsfilter = gst_element_factory_make("capsfilter", nullptr);
-    //	GstCaps *caps = gst_caps_new_empty();
-
-    // 	for(int n = 0; n < widths.count(); ++n)
-    // 	{
-    // 		GstStructure *cs;
-    // 		cs = gst_structure_new("video/x-raw-yuv",
-    // 			"width", GST_TYPE_INT_RANGE, 1, widths[n],
-    // 			"height", GST_TYPE_INT_RANGE, 1, G_MAXINT, nullptr);
-    // 		gst_caps_append_structure(caps, cs);
-    //
-    // 		cs = gst_structure_new("video/x-raw-rgb",
-    // 			"width", GST_TYPE_INT_RANGE, 1, widths[n],
-    // 			"height", GST_TYPE_INT_RANGE, 1, G_MAXINT, nullptr);
-    // 		gst_caps_append_structure(caps, cs);
-    // 	}
-    return gst_caps_new_simple("video/x-raw", "width", G_TYPE_INT, 640, "height", G_TYPE_INT, 480, "framerate",
-                               GST_TYPE_FRACTION, 30, 1, nullptr);
+    GstCaps *caps = gst_caps_new_empty();
+    foreach (const char *name, QList<const char *>() << "video/x-raw"
+                                                      << "image/jpeg") {
+        GstStructure *cs = gst_structure_new(name, "width", G_TYPE_INT, size.width(), "height", G_TYPE_INT,
+                                             size.height(), nullptr);
+        if (fps > 0)
+            gst_structure_set(cs, "framerate", GST_TYPE_FRACTION_RANGE, fps, 1, G_MAXINT, 1, nullptr);
+        gst_caps_append_structure(caps, cs);
+    }
+    gst_caps_append_structure(caps, gst_structure_new_empty("video/x-raw"));
+    gst_caps_append_structure(caps, gst_structure_new_empty("image/jpeg"));
+    return caps;
+}
+
+// the device has to be opened to learn its modes, so bring it to READY just
+//   for the query and put it back to NULL afterwards.  returns null if the
+//   element doesn't report anything useful.
+static GstCaps *query_device_caps(GstElement *e)
+{
+    GstPad *pad = gst_element_get_static_pad(e, "src");
+    if (!pad)
+        return nullptr;
+
+    GstCaps *caps = nullptr;
+    if (gst_element_set_state(e, GST_STATE_READY) != GST_STATE_CHANGE_FAILURE)
+        caps = gst_pad_query_caps(pad, nullptr);
+    gst_element_set_state(e, GST_STATE_NULL);
+    gst_object_unref(pad);
+
+    if (caps && (gst_caps_is_any(caps) || gst_caps_is_empty(caps))) {
+        gst_caps_unref(caps);
+        caps = nullptr;
+    }
+    return caps;
+}
+
+// rough per-pixel cost of getting a captured frame into the encoder's native
+//   format (I420).  jpeg decoding dominates everything else by far, so it is
+//   only worth picking when no raw mode can deliver the wanted size and rate.
+#define CAPTURE_COST_NATIVE 1
+#define CAPTURE_COST_CONVERT 2
+#define CAPTURE_COST_JPEG 8
+#define CAPTURE_COST_SCALE 1
+
+// one mode of the capture device, fixated as close as possible to what we want
+class CaptureMode {
+public:
+    GstStructure *structure = nullptr;
+    bool          raw       = false;
+    bool          native    = false; // raw I420, nothing to convert
+    QSize         size;
+    double        fps = 0;
+
+    // true if the mode has enough pixels and frames for what we want, so
+    //   that prep only ever needs to scale down and drop frames
+    bool satisfies(const QSize &want, int wantFps) const
+    {
+        return size.width() >= want.width() && size.height() >= want.height() && (wantFps <= 0 || fps >= wantFps);
+    }
+
+    // how much of the wanted pixel rate the mode can't deliver
+    double deficit(const QSize &want, int wantFps) const
+    {
+        double wantRate = double(want.width()) * want.height() * (wantFps > 0 ? wantFps : 1);
+        double haveRate = double(qMin(size.width(), want.width())) * qMin(size.height(), want.height())
+            * (wantFps > 0 ? qMin(fps > 0 ? fps : wantFps, double(wantFps)) : 1);
+        return qMax(0.0, wantRate - haveRate);
+    }
+
+    // total work per second until the frame reaches the encoder.  decoding
+    //   and conversion happen at the capture rate, before any frames are
+    //   dropped, so they are weighed with the device's rate.
+    double cost(const QSize &want, int wantFps) const
+    {
+        double rate      = fps > 0 ? fps : (wantFps > 0 ? wantFps : 30);
+        double pixelRate = double(size.width()) * size.height() * rate;
+        int    perPixel  = raw ? (native ? CAPTURE_COST_NATIVE : CAPTURE_COST_CONVERT) : CAPTURE_COST_JPEG;
+        if (size != want)
+            perPixel += CAPTURE_COST_SCALE;
+        return pixelRate * perPixel;
+    }
+};
+
+// modes that satisfy the wanted size and rate always win, and among them the
+//   cheapest one.  if none does, the one coming closest wins, again by cost.
+static bool capture_mode_better(const CaptureMode &a, const CaptureMode &b, const QSize &want, int fps)
+{
+    bool as = a.satisfies(want, fps);
+    bool bs = b.satisfies(want, fps);
+    if (as != bs)
+        return as;
+
+    if (!as) {
+        double ad = a.deficit(want, fps);
+        double bd = b.deficit(want, fps);
+        if (ad != bd)
+            return ad < bd;
+    }
+
+    return a.cost(want, fps) < b.cost(want, fps);
+}
+
+// returns fixed caps for the device mode closest to size/fps, or null if the
+//   device caps contain nothing we can capture from
+static GstCaps *pick_capture_mode(GstCaps *deviceCaps, const QSize &size, int fps)
+{
+    CaptureMode best;
+    for (guint n = 0; n < gst_caps_get_size(deviceCaps); ++n) {
+        const GstStructure *ds = gst_caps_get_structure(deviceCaps, n);
+
+        CaptureMode mode;
+        mode.raw = gst_structure_has_name(ds, "video/x-raw");
+        if (!mode.raw && !gst_structure_has_name(ds, "image/jpeg"))
+            continue;
+
+        GstStructure *s = gst_structure_copy(ds);
+        gst_structure_fixate_field_nearest_int(s, "width", size.width());
+        gst_structure_fixate_field_nearest_int(s, "height", size.height());
+        if (fps > 0)
+            gst_structure_fixate_field_nearest_fraction(s, "framerate", fps, 1);
+        if (mode.raw) {
+            gst_structure_fixate_field_string(s, "format", "I420");
+            mode.native = !g_strcmp0(gst_structure_get_string(s, "format"), "I420");
+        }
+
+        int w, h;
+        if (!gst_structure_get_int(s, "width", &w) || !gst_structure_get_int(s, "height", &h)) {
+            gst_structure_free(s);
+            continue;
+        }
+
+        int fps_n, fps_d;
+        if (gst_structure_get_fraction(s, "framerate", &fps_n, &fps_d) && fps_d > 0)
+            mode.fps = double(fps_n) / fps_d;
+
+        mode.structure = s;
+        mode.size      = QSize(w, h);
+
+        if (!best.structure || capture_mode_better(mode, best, size, fps)) {
+            if (best.structure)
+                gst_structure_free(best.structure);
+            best = mode;
+        } else
+            gst_structure_free(s);
+    }
+
+    if (!best.structure)
+        return nullptr;
+
+    // keep only the fields identifying the mode, the rest is up to the device
+    GstStructure *out = gst_structure_new_empty(gst_structure_get_name(best.structure));
+    foreach (const char *field, QList<const char *>() << "format"
+                                                       << "width"
+                                                       << "height"
+                                                       << "framerate") {
+        const GValue *v = gst_structure_get_value(best.structure, field);
+        if (v && gst_value_is_fixed(v))
+            gst_structure_set_value(out, field, v);
+    }
+    gst_structure_free(best.structure);
+
+#ifdef PIPELINE_DEBUG
+    gchar *str = gst_structure_to_string(out);
+    qDebug("picked capture mode: %s", str);
+    g_free(str);
+#endif
+
+    return gst_caps_new_full(out, nullptr);
+}
+
+// libav's mjpeg decoder can use several threads, jpegdec can't
+static GstElement *make_jpeg_decoder()
+{
+    GstElement *dec = gst_element_factory_make("avdec_mjpeg", nullptr);
+    if (dec) {
+        if (g_object_class_find_property(G_OBJECT_GET_CLASS(dec), "max-threads"))
+            g_object_set(G_OBJECT(dec), "max-threads", get_jpeg_threads(), nullptr);
+        return dec;
+    }
+    return gst_element_factory_make("jpegdec", nullptr);
 }
 
 static GstElement *make_webrtcdsp_filter()
@@ -188,13 +356,14 @@ public:
     GstElement *  pipeline   = nullptr;
     GstElement *  device_bin = nullptr;
     bool          activated  = false;
-    QString       webrtcEchoProbeName; // initialized when we modify already running AudioIn dev
+    QString       webrtcEchoProbeName; // of our probe for AudioOut, of the one the dsp uses for AudioIn
 
     QSet<PipelineDeviceContextPrivate *> contexts;
 
     // for srcs
     GstElement *tee                  = nullptr;
     GstElement *aindev               = nullptr;
+    GstElement *webrtcdsp            = nullptr;
     bool        webrtcdspInitialized = false;
 
     // for sinks (audio only, video sinks are always unshared)
@@ -203,6 +372,7 @@ public:
     GstElement *audioresample = nullptr;
     GstElement *capsfilter    = nullptr;
     GstElement *webrtcprobe   = nullptr;
+    GstElement *aoutdev       = nullptr;
 
 private:
     GstElement *makeDeviceBin(const PipelineDeviceOptions &options)
@@ -235,8 +405,9 @@ private:
                 GstElement *audioconvert  = gst_element_factory_make("audioconvert", nullptr);
                 GstElement *audioresample = gst_element_factory_make("audioresample", nullptr);
                 GstElement *capsfilter    = make_webrtcdsp_filter();
-                GstElement *webrtcdsp     = gst_element_factory_make("webrtcdsp", nullptr);
+                webrtcdsp                 = gst_element_factory_make("webrtcdsp", nullptr);
                 g_object_set(webrtcdsp, "probe", options.echoProberName.toLatin1().constData(), nullptr);
+                webrtcEchoProbeName = options.echoProberName;
 
                 gst_bin_add(GST_BIN(bin), audioconvert);
                 gst_bin_add(GST_BIN(bin), audioresample);
@@ -256,16 +427,15 @@ private:
             GstCaps *capsfilter = nullptr;
 
 #ifdef Q_OS_MAC
-            // FIXME: hardcode resolution because filter_for_desired_size
+            // FIXME: force the resolution because filter_for_desired_size
             //   doesn't really work with osxvideosrc due to the fact that
             //   it can handle any resolution.  for example, setting
             //   desiredSize to 320x240 yields a caps of 320x480 which is
             //   wrong (and may crash videoscale, but that's another
-            //   matter).  We'll hardcode the caps to 320x240, since that's
-            //   the resolution psimedia currently wants anyway,
+            //   matter).  We'll force the caps to exactly the wanted size,
             //   as opposed to not specifying a captureSize, which would
             //   also work fine but may result in double-resizing.
-            captureSize = QSize(640, 480);
+            captureSize = options.videoSize.isValid() ? options.videoSize : QSize(640, 480);
 #endif
             // return e; // fixme review if we need all the below. it seems it forces double conversion
             // (yuy2 -> Y42B for rtp and yuy2 for preview. while w/o it we have i420 on input and conert only for
@@ -273,30 +443,64 @@ private:
 
             if (captureSize.isValid())
                 capsfilter = filter_for_capture_size(captureSize);
-            else if (options.videoSize.isValid())
-                capsfilter = filter_for_desired_size(options.videoSize);
+            else if (options.videoSize.isValid()) {
+                GstCaps *deviceCaps = query_device_caps(e);
+                if (deviceCaps) {
+                    capsfilter = pick_capture_mode(deviceCaps, options.videoSize, options.fps);
+                    gst_caps_unref(deviceCaps);
+                }
+                if (!capsfilter)
+                    capsfilter = filter_for_desired_size(options.videoSize, options.fps);
+            }
 
             gst_bin_add(GST_BIN(bin), e);
 
-            GstElement *decodebin = gst_element_factory_make("decodebin", nullptr);
-            gst_bin_add(GST_BIN(bin), decodebin);
-
             GstPad *pad
                 = gst_ghost_pad_new_no_target_from_template("src", gst_static_pad_template_get(&videosrcbin_template));
             gst_element_add_pad(bin, pad);
 
-            g_signal_connect(G_OBJECT(decodebin), "pad-added", G_CALLBACK(videosrcbin_pad_added), pad);
-
-            if (capsfilter) {
-                gst_element_link_filtered(e, decodebin, capsfilter);
+            // if we know the device will give us jpeg, decode it ourselves
+            //   instead of letting decodebin pick the (single threaded)
+            //   decoder.  the queue puts decoding in its own thread, so
+            //   that it doesn't hold up the capture.
+            GstElement *jpegdec = nullptr;
+            if (capsfilter && gst_caps_get_size(capsfilter) == 1
+                && gst_structure_has_name(gst_caps_get_structure(capsfilter, 0), "image/jpeg"))
+                jpegdec = make_jpeg_decoder();
+
+            if (jpegdec) {
+                GstElement *queue = gst_element_factory_make("queue", nullptr);
+                g_object_set(G_OBJECT(queue), "leaky", 2, "max-size-buffers", 2, "max-size-bytes", 0,
+                             "max-size-time", G_GUINT64_CONSTANT(0), nullptr);
+
+                gst_bin_add(GST_BIN(bin), queue);
+                gst_bin_add(GST_BIN(bin), jpegdec);
+
+                gst_element_link_filtered(e, queue, capsfilter);
+                gst_element_link(queue, jpegdec);
                 gst_caps_unref(capsfilter);
+
+                GstPad *decpad = gst_element_get_static_pad(jpegdec, "src");
+                gst_ghost_pad_set_target(GST_GHOST_PAD(pad), decpad);
+                gst_object_unref(GST_OBJECT(decpad));
             } else {
-                gst_element_link(e, decodebin);
+                GstElement *decodebin = gst_element_factory_make("decodebin", nullptr);
+                gst_bin_add(GST_BIN(bin), decodebin);
+
+                g_signal_connect(G_OBJECT(decodebin), "pad-added", G_CALLBACK(videosrcbin_pad_added), pad);
+
+                if (capsfilter) {
+                    gst_element_link_filtered(e, decodebin, capsfilter);
+                    gst_caps_unref(capsfilter);
+                } else {
+                    gst_element_link(e, decodebin);
+                }
             }
         } else // AudioOut
         {
             GstElement *audioconvert  = gst_element_factory_make("audioconvert", nullptr);
             GstElement *audioresample = gst_element_factory_make("audioresample", nullptr);
+            aoutdev                   = e;
 
             gchar *name_value = nullptr;
             webrtcprobe       = gst_element_factory_make("webrtcechoprobe", nullptr);
@@ -412,6 +616,7 @@ public:
             return;
 
         if (type == PDevice::AudioIn || type == PDevice::VideoIn) {
+            // stopped already if the pipeline was running, see removeRef
             gst_bin_remove(GST_BIN(pipeline), device_bin);
 
             if (tee)
@@ -487,7 +692,16 @@ public:
             // deactivate if not done so already
             deactivate(context);
 
+            // the pipeline may still be running.  the device is stopped
+            //   first, so that it never pushes into an unlinked tee.
+            if (refs == 1) {
+                gst_element_set_state(device_bin, GST_STATE_NULL);
+                if (tee)
+                    gst_element_set_state(tee, GST_STATE_NULL);
+            }
+
             GstElement *queue = context->element;
+            gst_element_set_state(queue, GST_STATE_NULL);
             gst_bin_remove(GST_BIN(pipeline), queue);
         }
 
@@ -495,24 +709,42 @@ public:
         --refs;
     }
 
-    void activate(PipelineDeviceContextPrivate *context)
+    bool activate(PipelineDeviceContextPrivate *context)
     {
-        // activate the context
-        if (!context->activated) {
-            // GstElement *queue = context->element;
-            // gst_element_set_locked_state(queue, FALSE);
-            // gst_element_set_state(queue, GST_STATE_PLAYING);
+        // elements are brought up to the state of the pipeline downstream
+        //   first, so that nothing is pushed into an element not ready for
+        //   it yet
+        if (type == PDevice::AudioIn || type == PDevice::VideoIn) {
+            // activate the context
+            if (!gst_element_sync_state_with_parent(context->element))
+                return false;
             context->activated = true;
-        }
 
-        // activate the device
-        if (!activated) {
-            // gst_element_set_locked_state(tee, FALSE);
-            // gst_element_set_locked_state(bin, FALSE);
-            // gst_element_set_state(tee, GST_STATE_PLAYING);
-            // gst_element_set_state(bin, GST_STATE_PLAYING);
+            // activate the device
+            if (!gst_element_sync_state_with_parent(tee) || !gst_element_sync_state_with_parent(device_bin))
+                return false;
             activated = true;
+        } else // AudioOut
+        {
+            // a sink waiting for its first buffer would take the state of
+            //   a running pipeline away with it
+            GstState state = GST_STATE_NULL;
+            gst_element_get_state(pipeline, &state, nullptr, 0);
+            if (state == GST_STATE_PLAYING && g_object_class_find_property(G_OBJECT_GET_CLASS(aoutdev), "async"))
+                g_object_set(G_OBJECT(aoutdev), "async", FALSE, nullptr);
+
+            if (!gst_element_sync_state_with_parent(device_bin))
+                return false;
+            if (!gst_element_sync_state_with_parent(capsfilter))
+                return false;
+#ifdef USE_LIVEADDER
+            gst_element_sync_state_with_parent(audioresample);
+            gst_element_sync_state_with_parent(audioconvert);
+            gst_element_sync_state_with_parent(adder);
+#endif
         }
+
+        return true;
     }
 
     void deactivate(PipelineDeviceContextPrivate *context)
@@ -623,6 +855,7 @@ NULL
                     GstElement *capsfilter    = make_webrtcdsp_filter();
                     GstElement *webrtcdsp     = gst_element_factory_make("webrtcdsp", nullptr);
                     g_object_set(webrtcdsp, "probe", pipeline->webrtcEchoProbeName.toLatin1().constData(), nullptr);
+                    pipeline->webrtcdsp = webrtcdsp;
 
                     gst_bin_add(GST_BIN(pipeline->device_bin), audioconvert);
                     gst_bin_add(GST_BIN(pipeline->device_bin), audioresample);
@@ -646,6 +879,51 @@ NULL
             };
             GstPad *blockpad = gst_element_get_static_pad(aindev, "src");
             gst_pad_add_probe(blockpad, GST_PAD_PROBE_TYPE_BLOCK_DOWNSTREAM, &F::cb, this, nullptr);
+        } else if (type == PDevice::AudioIn && ctx.options().aec && webrtcdsp
+                   && ctx.options().echoProberName != webrtcEchoProbeName) {
+            // the output was switched.  webrtcdsp only looks up its probe
+            //   when it starts, so it is replaced by one for the new output.
+            webrtcEchoProbeName = ctx.options().echoProberName;
+
+            struct F {
+                static GstPadProbeReturn cb(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+                {
+                    PipelineDevice *pipeline = reinterpret_cast<PipelineDevice *>(user_data);
+                    gst_pad_remove_probe(pad, GST_PAD_PROBE_INFO_ID(info));
+
+                    GstElement *old       = pipeline->webrtcdsp;
+                    GstElement *webrtcdsp = gst_element_factory_make("webrtcdsp", nullptr);
+                    g_object_set(webrtcdsp, "probe", pipeline->webrtcEchoProbeName.toLatin1().constData(), nullptr);
+
+                    GstPad *oldSink = gst_element_get_static_pad(old, "sink");
+                    gst_pad_unlink(pad, oldSink);
+                    gst_object_unref(oldSink);
+                    gst_element_set_state(old, GST_STATE_NULL);
+                    gst_bin_remove(GST_BIN(pipeline->device_bin), old);
+
+                    gst_bin_add(GST_BIN(pipeline->device_bin), webrtcdsp);
+                    GstPad *sink = gst_element_get_static_pad(webrtcdsp, "sink");
+                    gst_pad_link(pad, sink);
+                    gst_object_unref(sink);
+
+                    GstPad *src    = gst_element_get_static_pad(webrtcdsp, "src");
+                    GstPad *binPad = gst_element_get_static_pad(pipeline->device_bin, "src");
+                    gst_ghost_pad_set_target((GstGhostPad *)binPad, src);
+                    g_object_unref(G_OBJECT(binPad));
+                    gst_object_unref(src);
+
+                    gst_element_sync_state_with_parent(webrtcdsp);
+                    pipeline->webrtcdsp = webrtcdsp;
+                    return GST_PAD_PROBE_REMOVE;
+                }
+            };
+            GstPad *dspSink  = gst_element_get_static_pad(webrtcdsp, "sink");
+            GstPad *blockpad = gst_pad_get_peer(dspSink);
+            gst_object_unref(dspSink);
+            if (blockpad) {
+                gst_pad_add_probe(blockpad, GST_PAD_PROBE_TYPE_BLOCK_DOWNSTREAM, &F::cb, this, nullptr);
+                gst_object_unref(blockpad);
+            }
         }
     }
 
@@ -769,12 +1047,14 @@ PipelineDeviceContext::~PipelineDeviceContext()
     delete d;
 }
 
-void PipelineDeviceContext::activate() { d->device->activate(d); }
+bool PipelineDeviceContext::activate() { return d->device->activate(d); }
 
 void PipelineDeviceContext::deactivate() { d->device->deactivate(d); }
 
 GstElement *PipelineDeviceContext::element() { return d->element; }
 
+QString PipelineDeviceContext::id() const { return d->device->id; }
+
 void PipelineDeviceContext::setOptions(const PipelineDeviceOptions &opts)
 {
     d->opts = opts;
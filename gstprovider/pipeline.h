@@ -75,15 +75,15 @@ public:
 
     // after creation, the device element is in the NULL state, and
     //   potentially not linked to dependent internal elements.  call
-    //   activate() to cause internals to be finalized and set to
-    //   PLAYING.  the purpose of the activate() call is to give you time
-    //   to get your own elements into the pipeline, linked, and perhaps
-    //   set to PLAYING before the device starts working.
+    //   activate() to bring the device up to the state of the pipeline.
+    //   the purpose of the activate() call is to give you time to get
+    //   your own elements into the pipeline, linked, and perhaps set to
+    //   PLAYING before the device starts working.  returns false if the
+    //   device could not be started.
     //
-    // note: this only applies to input (src) elements.  output (sink)
-    //   elements start out activated.
-    // FIXME: this function currently does nothing
-    void activate();
+    // note: a pipeline being set to PLAYING takes its devices along, so
+    //   this is only needed for devices added to a running pipeline.
+    bool activate();
 
     // call this in order to stop the device element.  it will be safely
     //   set to the NULL state, so that you may then unlink your own
@@ -92,6 +92,7 @@ public:
     void deactivate();
 
     GstElement *          element();
+    QString               id() const;
     void                  setOptions(const PipelineDeviceOptions &opts);
     PipelineDeviceOptions options() const;
 
@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+#include "rtprelay.h"
+
+#include <QDateTime>
+#include <glib.h>
+
+// fixed rtp header, without csrcs or extensions
+#define RTP_HEADER_SIZE 12
+
+// seconds from the ntp epoch (1900) to the unix one
+#define NTP_UNIX_OFFSET 2208988800u
+
+namespace PsiMedia {
+
+static quint16 read16(const uchar *p) { return quint16((p[0] << 8) | p[1]); }
+
+static quint32 read32(const uchar *p)
+{
+    return (quint32(p[0]) << 24) | (quint32(p[1]) << 16) | (quint32(p[2]) << 8) | quint32(p[3]);
+}
+
+static void write16(uchar *p, quint16 x)
+{
+    p[0] = uchar(x >> 8);
+    p[1] = uchar(x);
+}
+
+static void write32(uchar *p, quint32 x)
+{
+    p[0] = uchar(x >> 24);
+    p[1] = uchar(x >> 16);
+    p[2] = uchar(x >> 8);
+    p[3] = uchar(x);
+}
+
+RtpRewriter::RtpRewriter(int clockrate) :
+    clockrate_(clockrate), outSsrc_(g_random_int()), inSsrc_(-1), seqOffset_(0), tsOffset_(0), lastSeq_(0),
+    lastTs_(0), started_(false), packets_(0), octets_(0)
+{
+}
+
+void RtpRewriter::setClockRate(int clockrate) { clockrate_ = clockrate; }
+
+void RtpRewriter::resync() { inSsrc_ = -1; }
+
+bool RtpRewriter::rewrite(QByteArray *packet, const QHash<int, int> &ptMap)
+{
+    if (packet->size() < RTP_HEADER_SIZE)
+        return false;
+
+    uchar *p = reinterpret_cast<uchar *>(packet->data());
+    if ((p[0] >> 6) != 2)
+        return false;
+
+    int pt = p[1] & 0x7f;
+    if (!ptMap.isEmpty()) {
+        if (!ptMap.contains(pt))
+            return false;
+        pt = ptMap.value(pt);
+    }
+
+    quint16 seq  = read16(p + 2);
+    quint32 ts   = read32(p + 4);
+    quint32 ssrc = read32(p + 8);
+
+    if (qint64(ssrc) != inSsrc_) {
+        // a new source: carry on right after the last packet we sent, with
+        //   the timestamp advanced by the time that has passed since.  the
+        //   receiver then sees a short gap rather than a jump.
+        if (started_) {
+            qint64 elapsed = sinceLast_.elapsed();
+            seqOffset_     = quint16(lastSeq_ + 1 - seq);
+            tsOffset_      = quint32(lastTs_ + quint32(qMax<qint64>(1, elapsed * clockrate_ / 1000)) - ts);
+        } else {
+            seqOffset_ = 0;
+            tsOffset_  = 0;
+        }
+        inSsrc_ = ssrc;
+    }
+
+    quint16 outSeq = quint16(seq + seqOffset_);
+    quint32 outTs  = quint32(ts + tsOffset_);
+
+    // reordered or retransmitted packets must not pull the reference back
+    if (!started_ || qint16(outSeq - lastSeq_) > 0) {
+        lastSeq_ = outSeq;
+        lastTs_  = outTs;
+        sinceLast_.start();
+    }
+    started_ = true;
+
+    p[1] = uchar((p[1] & 0x80) | pt);
+    write16(p + 2, outSeq);
+    write32(p + 4, outTs);
+    write32(p + 8, outSsrc_);
+
+    ++packets_;
+    octets_ += quint32(packet->size() - RTP_HEADER_SIZE - (p[0] & 0x0f) * 4);
+    return true;
+}
+
+quint32 RtpRewriter::ssrc() const { return outSsrc_; }
+
+void RtpRewriter::setSsrc(quint32 ssrc) { outSsrc_ = ssrc; }
+
+qint64 RtpRewriter::sourceSsrc() const { return inSsrc_; }
+
+QByteArray RtpRewriter::senderReport(const QByteArray &cname) const
+{
+    if (!started_)
+        return QByteArray();
+
+    // the rtp timestamp has to match the wallclock time, so extrapolate it
+    //   from the last packet sent
+    qint64  now = QDateTime::currentMSecsSinceEpoch();
+    quint32 ts  = quint32(lastTs_ + quint32(sinceLast_.elapsed() * clockrate_ / 1000));
+
+    QByteArray sr(28, 0);
+    uchar     *p = reinterpret_cast<uchar *>(sr.data());
+    p[0]         = 0x80; // v=2, no report blocks
+    p[1]         = 200;
+    write16(p + 2, 6);
+    write32(p + 4, outSsrc_);
+    write32(p + 8, quint32(now / 1000) + NTP_UNIX_OFFSET);
+    write32(p + 12, quint32(((now % 1000) << 32) / 1000));
+    write32(p + 16, ts);
+    write32(p + 20, packets_);
+    write32(p + 24, octets_);
+
+    // sdes with a single cname item, null terminated and padded to 32 bits
+    QByteArray name     = cname.left(255);
+    int        itemSize = 2 + name.size() + 1;
+    int        size     = 8 + ((itemSize + 3) & ~3);
+    QByteArray sdes(size, 0);
+    p    = reinterpret_cast<uchar *>(sdes.data());
+    p[0] = 0x81; // v=2, one chunk
+    p[1] = 202;
+    write16(p + 2, quint16(size / 4 - 1));
+    write32(p + 4, outSsrc_);
+    p[8] = 1; // cname
+    p[9] = uchar(name.size());
+    memcpy(p + 10, name.constData(), size_t(name.size()));
+
+    return sr + sdes;
+}
+
+QHash<int, int> relay_payload_map(const QList<PPayloadInfo> &from, const QList<PPayloadInfo> &to)
+{
+    QHash<int, int> map;
+    if (from.isEmpty() || to.isEmpty())
+        return map;
+
+    foreach (const PPayloadInfo &f, from) {
+        foreach (const PPayloadInfo &t, to) {
+            if (f.name.compare(t.name, Qt::CaseInsensitive) == 0 && f.clockrate == t.clockrate
+                && f.channels == t.channels) {
+                map.insert(f.id, t.id);
+                break;
+            }
+        }
+    }
+    return map;
+}
+
+qint64 rtp_packet_ssrc(const QByteArray &packet)
+{
+    if (packet.size() < RTP_HEADER_SIZE)
+        return -1;
+
+    const uchar *p = reinterpret_cast<const uchar *>(packet.constData());
+    if ((p[0] >> 6) != 2)
+        return -1;
+    return read32(p + 8);
+}
+
+QByteArray rtcp_key_frame_request(quint32 senderSsrc, quint32 mediaSsrc)
+{
+    QByteArray pli(12, 0);
+    uchar     *p = reinterpret_cast<uchar *>(pli.data());
+    p[0]         = 0x81; // v=2, fmt=1 (pli)
+    p[1]         = 206;  // payload-specific feedback
+    write16(p + 2, 2);
+    write32(p + 4, senderSsrc);
+    write32(p + 8, mediaSsrc);
+    return pli;
+}
+
+bool rtcp_is_key_frame_request(const QByteArray &packet)
+{
+    const uchar *p   = reinterpret_cast<const uchar *>(packet.constData());
+    int          at  = 0;
+    int          end = packet.size();
+    while (end - at >= 4) {
+        if ((p[at] >> 6) != 2)
+            return false;
+        int fmt  = p[at] & 0x1f;
+        int type = p[at + 1];
+        int size = (((p[at + 2] << 8) | p[at + 3]) + 1) * 4;
+        if (type == 206 && (fmt == 1 || fmt == 4)) // pli, fir
+            return true;
+        at += size;
+    }
+    return false;
+}
+
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+#ifndef PSI_RTPRELAY_H
+#define PSI_RTPRELAY_H
+
+#include "psimediaprovider.h"
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+
+namespace PsiMedia {
+
+// rewrites relayed rtp packets so that whatever sources get forwarded, the
+//   receiving peer sees a single stream: one ssrc of our own, with sequence
+//   numbers and timestamps that continue smoothly when the source switches.
+//   the payload itself is never touched.
+class RtpRewriter {
+public:
+    RtpRewriter(int clockrate = 90000);
+
+    void setClockRate(int clockrate);
+
+    // treat the next packet as coming from a new source even if the ssrc
+    //   is the same, for when the input starts over
+    void resync();
+
+    // rewrite packet in place.  payload types are translated through
+    //   ptMap (source pt -> target pt).  an empty map passes them through
+    //   as they are, otherwise packets of an unmapped type are refused.
+    //   returns false if the packet should be dropped.
+    bool rewrite(QByteArray *packet, const QHash<int, int> &ptMap);
+
+    // the ssrc the receiving peer sees, random unless set
+    quint32 ssrc() const;
+    void    setSsrc(quint32 ssrc);
+
+    // the ssrc of the source currently being rewritten, -1 if none yet
+    qint64 sourceSsrc() const;
+
+    // since rtcp is not relayed, the peer learns nothing about our stream
+    //   unless we tell it.  this builds a compound rtcp packet (sender
+    //   report plus sdes cname) describing what has been sent so far, or
+    //   returns an empty array if nothing has.
+    QByteArray senderReport(const QByteArray &cname) const;
+
+private:
+    int     clockrate_;
+    quint32 outSsrc_;
+    qint64  inSsrc_; // -1 until the first packet
+    quint16 seqOffset_;
+    quint32 tsOffset_;
+    quint16 lastSeq_; // last ones sent out
+    quint32 lastTs_;
+    bool    started_;
+    quint32 packets_; // sent out, for the sender reports
+    quint32 octets_;
+
+    QElapsedTimer sinceLast_; // for the timestamp gap when switching
+};
+
+// map the payload types of one side to those of the other, by codec, for
+//   use with RtpRewriter.  if either side is unknown the map is empty, and
+//   the payload types are left alone.
+QHash<int, int> relay_payload_map(const QList<PPayloadInfo> &from, const QList<PPayloadInfo> &to);
+
+// ssrc of an rtp packet, or -1 if it isn't one
+qint64 rtp_packet_ssrc(const QByteArray &packet);
+
+// rtcp picture loss indication (rfc 4585), asking the sender of mediaSsrc
+//   for a key frame
+QByteArray rtcp_key_frame_request(quint32 senderSsrc, quint32 mediaSsrc);
+
+// whether a (compound) rtcp packet asks for a key frame, by picture loss
+//   indication or full intra request
+bool rtcp_is_key_frame_request(const QByteArray &packet);
+
+}
+
+#endif
@@ -24,15 +24,23 @@
 #include <QTime>
 #include <cstring>
 #include <gst/app/gstappsrc.h>
+#include <gst/video/video.h>
 #include <stdio.h>
 
+#include "audiomixer.h"
 #include "bins.h"
+#include "bitratecontroller.h"
+#include "callrecorder.h"
 #include "devices.h"
+#include "deviceswap.h"
+#include "filecache.h"
+#include "fileloop.h"
+#include "filereplay.h"
+#include "latencycontroller.h"
+#include "memorysource.h"
 #include "payloadinfo.h"
 #include "pipeline.h"
-
-// TODO: support playing from bytearray
-// TODO: support recording
+#include "rtprelay.h"
 
 #define RTPWORKER_DEBUG
 
@@ -134,6 +142,91 @@ static void dump_pipeline(GstElement *in, int indent)
 }
 #endif
 
+// used when the app doesn't ask for a particular video mode.  on low
+//   bitrates a smaller, slower picture looks better than a blocky large one.
+#define DEFAULT_VIDEO_SIZE QSize(640, 480)
+#define DEFAULT_VIDEO_FPS 30
+#define LOWBITRATE_VIDEO_SIZE QSize(320, 240)
+#define LOWBITRATE_VIDEO_FPS 15
+#define LOWBITRATE_VIDEO_KBPS 256
+
+// when no opus mode was asked for.  this only limits the coded bandwidth,
+//   the audio itself runs at 48khz
+#define DEFAULT_OPUS_RATE 16000
+
+static void video_params_for_send(const QList<PVideoParams> &params, int maxbitrate, QSize *size, int *fps)
+{
+    foreach (const PVideoParams &p, params) {
+        if (p.size.isValid() && p.fps > 0) {
+            *size = p.size;
+            *fps  = p.fps;
+            return;
+        }
+    }
+
+    if (maxbitrate > 0 && maxbitrate <= LOWBITRATE_VIDEO_KBPS) {
+        *size = LOWBITRATE_VIDEO_SIZE;
+        *fps  = LOWBITRATE_VIDEO_FPS;
+    } else {
+        *size = DEFAULT_VIDEO_SIZE;
+        *fps  = DEFAULT_VIDEO_FPS;
+    }
+}
+
+// how often rtp session statistics are collected, in milliseconds
+#define STATS_INTERVAL 1000
+
+// retransmitted video is kept this long (ms) and up to this many packets.
+//   anything older would arrive after the remote's jitterbuffer gave up.
+#define RTX_CACHE_TIME 1000
+#define RTX_CACHE_PACKETS 256
+
+// we ask for a key frame at most this often (ms), and the encoder produces
+//   unscheduled ones at most this often, however many receivers ask
+#define KEYFRAME_REQUEST_INTERVAL 1000
+#define KEYFRAME_MIN_INTERVAL 500
+
+// how long (ms) to wait for a conference sender to negotiate its caps
+#define MIX_CAPS_TIMEOUT 2000
+
+// how long a recording still going when the session stops gets to finish
+//   (ms)
+#define RECORD_STOP_TIMEOUT 2000
+
+// pre-encoded file streams are sent without transcoding where possible,
+//   setting this turns that off
+static bool get_file_transcode() { return !qgetenv("PSI_FILE_TRANSCODE").isEmpty(); }
+
+// recordings store the encoded streams as they are sent and received.
+//   setting this mixes the audio of both sides into one stream instead.
+static bool get_record_transcode() { return !qgetenv("PSI_RECORD_TRANSCODE").isEmpty(); }
+
+// preview is usually a thumbnail, no need to render it at the capture rate
+#define DEFAULT_PREVIEW_FPS 15
+
+static int get_preview_fps()
+{
+    QString val = QString::fromLatin1(qgetenv("PSI_PREVIEW_FPS"));
+    if (!val.isEmpty())
+        return qMax(val.toInt(), 0);
+    else
+        return DEFAULT_PREVIEW_FPS;
+}
+
+// lets videoscale pick any size fitting into maxSize, keeping the aspect.
+//   the pixels have to stay square, or videoscale would keep the aspect
+//   through the pixel aspect ratio instead, which QImage ignores.  without
+//   a limit that still holds: a remote may well send non-square pixels.
+static GstCaps *video_max_size_caps(const QSize &maxSize)
+{
+    if (!maxSize.isValid())
+        return gst_caps_new_simple("video/x-raw", "pixel-aspect-ratio", GST_TYPE_FRACTION, 1, 1, nullptr);
+
+    return gst_caps_new_simple("video/x-raw", "width", GST_TYPE_INT_RANGE, 1, maxSize.width(), "height",
+                               GST_TYPE_INT_RANGE, 1, maxSize.height(), "pixel-aspect-ratio", GST_TYPE_FRACTION, 1,
+                               1, nullptr);
+}
+
 //----------------------------------------------------------------------------
 // RtpWorker
 //----------------------------------------------------------------------------
@@ -159,12 +252,20 @@ RtpWorker::RtpWorker(GMainContext *mainContext) :
     mainContext_(mainContext), timer(nullptr), pd_audiosrc(nullptr), pd_videosrc(nullptr), pd_audiosink(nullptr),
     sendbin(nullptr), recvbin(nullptr), fileDemux(nullptr), audiosrc(nullptr), videosrc(nullptr), audiortpsrc(nullptr),
     videortpsrc(nullptr), audiortppay(nullptr), videortppay(nullptr), volumein(nullptr), volumeout(nullptr),
-    rtpaudioout(false), rtpvideoout(false)
+    rtpaudioout(false), rtpvideoout(false), sendShare(mainContext)
 // recordTimer(0)
 {
     audioStats = new Stats("audio");
     videoStats = new Stats("video");
 
+    sendShare.app       = this;
+    sendShare.cb_packet = cb_sharedPacket;
+    sendShare.cb_lost   = cb_shareLost;
+
+    shareCname = "psimedia-" + QByteArray::number(g_random_int(), 16);
+    audioSsrc  = g_random_int();
+    videoSsrc  = g_random_int();
+
     if (worker_refs == 0) {
         send_pipelineContext = new PipelineContext;
         recv_pipelineContext = new PipelineContext;
@@ -202,6 +303,7 @@ RtpWorker::~RtpWorker()
     }*/
 
     cleanup();
+    delete recorder;
 
     --worker_refs;
     if (worker_refs == 0) {
@@ -231,6 +333,15 @@ void RtpWorker::cleanup()
     volumeout = nullptr;
     volumeout_mutex.unlock();
 
+    preview_mutex.lock();
+    previewrate   = nullptr;
+    previewfilter = nullptr;
+    preview_mutex.unlock();
+
+    output_mutex.lock();
+    outputfilter = nullptr;
+    output_mutex.unlock();
+
     audiortpsrc_mutex.lock();
     audiortpsrc = nullptr;
     audiortpsrc_mutex.unlock();
@@ -239,6 +350,54 @@ void RtpWorker::cleanup()
     videortpsrc = nullptr;
     videortpsrc_mutex.unlock();
 
+    audiortcpsrc_mutex.lock();
+    audiosendrtcpsrc = nullptr;
+    audiorecvrtcpsrc = nullptr;
+    audiortcpsrc_mutex.unlock();
+
+    videortcpsrc_mutex.lock();
+    videosendrtcpsrc = nullptr;
+    videorecvrtcpsrc = nullptr;
+    videortcpsrc_mutex.unlock();
+
+    if (statsTimer) {
+        g_source_destroy(statsTimer);
+        g_source_unref(statsTimer);
+        statsTimer = nullptr;
+    }
+
+    audiosendsession = nullptr;
+    videosendsession = nullptr;
+    audiorecvsession = nullptr;
+    videorecvsession = nullptr;
+
+    delete videoBitrate;
+    videoBitrate   = nullptr;
+    videoReportSeq = -1;
+    videoencoder   = nullptr;
+    videopreprate  = nullptr;
+
+    audioEncParams   = PAudioParams();
+    audioencoder     = nullptr;
+    audioLossPercent = -1;
+
+    delete audioLatency;
+    audioLatency = nullptr;
+    delete videoLatency;
+    videoLatency      = nullptr;
+    audiojitterbuffer = nullptr;
+    videojitterbuffer = nullptr;
+    videoRtxSendPt    = -1;
+    videoRtxRecvPt    = -1;
+    videoRecvSsrc     = -1;
+    keyframeRequested.invalidate();
+    keyframeForced.invalidate();
+
+    netstats_mutex.lock();
+    audioNetStats = NetworkStats();
+    videoNetStats = NetworkStats();
+    netstats_mutex.unlock();
+
     rtpaudioout_mutex.lock();
     rtpaudioout = false;
     rtpaudioout_mutex.unlock();
@@ -253,6 +412,28 @@ void RtpWorker::cleanup()
     // if(pd_videosrc)
     //	pd_videosrc->deactivate();
 
+    sendShare.leave();
+
+    mixcaps_mutex.lock();
+    if (mixCapsTimer) {
+        g_source_destroy(mixCapsTimer);
+        g_source_unref(mixCapsTimer);
+        mixCapsTimer = nullptr;
+    }
+    mixcaps_mutex.unlock();
+
+    delete fileReplay;
+    fileReplay = nullptr;
+
+    // bins in a conference pipeline just leave it, without disturbing the
+    //   shared pipelines
+    if (audioMix) {
+        if (sendbin && audioMix->removeBin(sendbin))
+            sendbin = nullptr;
+        if (recvbin && audioMix->removeBin(recvbin))
+            recvbin = nullptr;
+    }
+
     if (sendbin) {
         if (shared_clock && send_clock_is_shared) {
             gst_object_unref(shared_clock);
@@ -319,6 +500,12 @@ void RtpWorker::cleanup()
         recv_in_use = false;
     }
 
+    // a device may live on in a pipeline shared with other sessions, so a
+    //   swap can still be switching.  finishDeviceSwap() stops that first.
+    for (DeviceSwap *swap : deviceSwaps)
+        finishDeviceSwap(swap);
+    deviceSwaps.clear();
+
     if (pd_audiosrc) {
         delete pd_audiosrc;
         pd_audiosrc = nullptr;
@@ -336,6 +523,30 @@ void RtpWorker::cleanup()
         pd_audiosink = nullptr;
     }
 
+    delete audioMix;
+    audioMix = nullptr;
+
+    // the sinks are gone, nothing else can come in
+    delete fileLoop;
+    fileLoop = nullptr;
+
+    filerecord_mutex.lock();
+    if (fileFinishedTimer) {
+        g_source_destroy(fileFinishedTimer);
+        g_source_unref(fileFinishedTimer);
+        fileFinishedTimer = nullptr;
+    }
+    if (fileStoreTimer) {
+        g_source_destroy(fileStoreTimer);
+        g_source_unref(fileStoreTimer);
+        fileStoreTimer = nullptr;
+    }
+    fileRecording.clear();
+    fileRecordDone   = false;
+    fileStreams      = 0;
+    fileStreamsEnded = 0;
+    filerecord_mutex.unlock();
+
 #ifdef RTPWORKER_DEBUG
     qDebug("cleaning done.\n");
 #endif
@@ -428,8 +639,36 @@ GstAppSink *RtpWorker::makeVideoPlayAppSink(const gchar *name)
     return appVideoSink;
 }
 
+// the sending side needs the remote's receiver reports and the receiving
+//   side needs its sender reports, so every rtcp packet goes to both
+static void push_rtcp(GstElement *sendsrc, GstElement *recvsrc, const PRtpPacket &packet)
+{
+    if (!sendsrc && !recvsrc)
+        return;
+
+    GstBuffer *buffer = makeGstBuffer(packet);
+    if (!buffer)
+        return;
+
+    if (sendsrc && recvsrc)
+        gst_app_src_push_buffer((GstAppSrc *)sendsrc, gst_buffer_ref(buffer));
+    gst_app_src_push_buffer((GstAppSrc *)(recvsrc ? recvsrc : sendsrc), buffer);
+}
+
 void RtpWorker::rtpAudioIn(const PRtpPacket &packet)
 {
+    if (packet.portOffset == 1) {
+        QMutexLocker locker(&audiortcpsrc_mutex);
+        push_rtcp(audiosendrtcpsrc, audiorecvrtcpsrc, packet);
+        return;
+    }
+
+    {
+        QMutexLocker locker(&record_mutex);
+        if (packet.portOffset == 0 && recorder)
+            recorder->pushAudio(false, packet.rawValue);
+    }
+
     QMutexLocker locker(&audiortpsrc_mutex);
     if (packet.portOffset == 0 && audiortpsrc) {
         gst_app_src_push_buffer((GstAppSrc *)audiortpsrc, makeGstBuffer(packet));
@@ -438,11 +677,40 @@ void RtpWorker::rtpAudioIn(const PRtpPacket &packet)
 
 void RtpWorker::rtpVideoIn(const PRtpPacket &packet)
 {
+    if (packet.portOffset == 1) {
+        // our remote lost the picture, but the encoder making it may be
+        //   another session's
+        if (rtcp_is_key_frame_request(packet.rawValue))
+            sendShare.requestKeyFrame();
+
+        QMutexLocker locker(&videortcpsrc_mutex);
+        push_rtcp(videosendrtcpsrc, videorecvrtcpsrc, packet);
+        return;
+    }
+
+    {
+        QMutexLocker locker(&record_mutex);
+        if (packet.portOffset == 0 && recorder)
+            recorder->pushVideo(false, packet.rawValue);
+    }
+
     QMutexLocker locker(&videortpsrc_mutex);
     if (packet.portOffset == 0 && videortpsrc)
         gst_app_src_push_buffer((GstAppSrc *)videortpsrc, makeGstBuffer(packet));
 }
 
+RtpWorker::NetworkStats RtpWorker::audioNetworkStats()
+{
+    QMutexLocker locker(&netstats_mutex);
+    return audioNetStats;
+}
+
+RtpWorker::NetworkStats RtpWorker::videoNetworkStats()
+{
+    QMutexLocker locker(&netstats_mutex);
+    return videoNetStats;
+}
+
 void RtpWorker::setOutputVolume(int level)
 {
     QMutexLocker locker(&volumeout_mutex);
@@ -463,17 +731,113 @@ void RtpWorker::setInputVolume(int level)
     }
 }
 
+void RtpWorker::setPreviewLimits(const QSize &maxSize, int maxFps)
+{
+    QMutexLocker locker(&preview_mutex);
+    previewMaxSize = maxSize;
+    previewMaxFps  = maxFps < 0 ? get_preview_fps() : maxFps;
+    if (previewrate)
+        g_object_set(G_OBJECT(previewrate), "max-rate", previewMaxFps > 0 ? previewMaxFps : G_MAXINT, nullptr);
+    if (previewfilter) {
+        GstCaps *caps = video_max_size_caps(previewMaxSize);
+        g_object_set(G_OBJECT(previewfilter), "caps", caps, nullptr);
+        gst_caps_unref(caps);
+    }
+}
+
+void RtpWorker::setOutputMaxSize(const QSize &maxSize)
+{
+    QMutexLocker locker(&output_mutex);
+    outputMaxSize = maxSize;
+    if (outputfilter) {
+        GstCaps *caps = video_max_size_caps(outputMaxSize);
+        g_object_set(G_OBJECT(outputfilter), "caps", caps, nullptr);
+        gst_caps_unref(caps);
+    }
+}
+
+// the opus entry in a payload list to use, -1 if none.  older peers also
+//   list a narrowband entry at clock rate 8000, prefer the real one.
+static int opus_payload_at(const QList<PPayloadInfo> &list)
+{
+    int at        = -1;
+    int clockrate = -1;
+    for (int n = 0; n < list.count(); ++n) {
+        const PPayloadInfo &pi = list[n];
+        if (pi.name.toUpper() == "OPUS" && pi.clockrate > clockrate) {
+            at        = n;
+            clockrate = pi.clockrate;
+        }
+    }
+    return at;
+}
+
+static int theora_payload_at(const QList<PPayloadInfo> &list)
+{
+    for (int n = 0; n < list.count(); ++n) {
+        if (list[n].name.toUpper() == "THEORA" && list[n].clockrate == 90000)
+            return n;
+    }
+    return -1;
+}
+
+// what to record of a stream in each direction, at the positions found by
+//   payload_at.  we send with the remote's payload type once we know it,
+//   but the rest (the theora configuration) is our own.
+static void record_payloads(const QList<PPayloadInfo> &local, const QList<PPayloadInfo> &remote,
+                            int (*payload_at)(const QList<PPayloadInfo> &), PPayloadInfo *sent,
+                            PPayloadInfo *received)
+{
+    int at = payload_at(remote);
+    if (at != -1)
+        *received = remote[at];
+
+    int local_at = payload_at(local);
+    if (local_at != -1) {
+        *sent = local[local_at];
+        if (at != -1)
+            sent->id = remote[at].id;
+    }
+}
+
 void RtpWorker::recordStart()
 {
-    // FIXME: for now we just send EOF/error
-    if (cb_recordData)
-        cb_recordData(QByteArray(), app);
+    record_mutex.lock();
+    delete recorder;
+    recorder = nullptr;
+    record_mutex.unlock();
+
+    PPayloadInfo sentAudio, receivedAudio, sentVideo, receivedVideo;
+    record_payloads(actual_localAudioPayloadInfo, actual_remoteAudioPayloadInfo, opus_payload_at, &sentAudio,
+                    &receivedAudio);
+    record_payloads(actual_localVideoPayloadInfo, actual_remoteVideoPayloadInfo, theora_payload_at, &sentVideo,
+                    &receivedVideo);
+
+    CallRecorder::Mode mode = get_record_transcode() ? CallRecorder::Mixed : CallRecorder::Passthrough;
+    CallRecorder *     r    = new CallRecorder(cb_recorder_data, this);
+    if (!r->start(mode, sentAudio, receivedAudio, sentVideo, receivedVideo)) {
+        delete r;
+        if (cb_recordData)
+            cb_recordData(QByteArray(), app);
+        return;
+    }
+
+    QMutexLocker locker(&record_mutex);
+    recorder = r;
 }
 
 void RtpWorker::recordStop()
 {
-    // TODO: assert recording
-    // FIXME: don't just do nothing
+    QMutexLocker locker(&record_mutex);
+    if (recorder)
+        recorder->stop();
+}
+
+void RtpWorker::cb_recorder_data(const QByteArray &buf, void *data)
+{
+    RtpWorker *self = static_cast<RtpWorker *>(data);
+    if (self->cb_recordData)
+        self->cb_recordData(buf, self->app);
 }
 
 gboolean RtpWorker::cb_doStart(gpointer data) { return static_cast<RtpWorker *>(data)->doStart(); }
@@ -482,6 +846,29 @@ gboolean RtpWorker::cb_doUpdate(gpointer data) { return static_cast<RtpWorker *>
 
 gboolean RtpWorker::cb_doStop(gpointer data) { return static_cast<RtpWorker *>(data)->doStop(); }
 
+gboolean RtpWorker::cb_doStats(gpointer data) { return static_cast<RtpWorker *>(data)->doStats(); }
+
+GstPadProbeReturn RtpWorker::cb_video_recv_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+    return static_cast<RtpWorker *>(data)->video_recv_probe(pad, info);
+}
+
+GstPadProbeReturn RtpWorker::cb_video_keyframe_request(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+    Q_UNUSED(pad)
+    return static_cast<RtpWorker *>(data)->video_keyframe_request(info);
+}
+
+void RtpWorker::cb_deviceSwapped(DeviceSwap *swap, void *data) { static_cast<RtpWorker *>(data)->deviceSwapped(swap); }
+
+GstPadProbeReturn RtpWorker::cb_mix_caps_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data)
+{
+    Q_UNUSED(pad)
+    return static_cast<RtpWorker *>(data)->mix_caps_probe(info);
+}
+
+gboolean RtpWorker::cb_mixCaps(gpointer data) { return static_cast<RtpWorker *>(data)->mixCaps(); }
+
 void RtpWorker::cb_fileDemux_no_more_pads(GstElement *element, gpointer data)
 {
     static_cast<RtpWorker *>(data)->fileDemux_no_more_pads(element);
@@ -522,6 +909,26 @@ GstFlowReturn RtpWorker::cb_packet_ready_rtp_video(GstAppSink *appsink, gpointer
     return static_cast<RtpWorker *>(data)->packet_ready_rtp_video(appsink);
 }
 
+GstFlowReturn RtpWorker::cb_packet_ready_rtcp_audio_send(GstAppSink *appsink, gpointer data)
+{
+    return static_cast<RtpWorker *>(data)->packet_ready_rtcp(appsink, false, true);
+}
+
+GstFlowReturn RtpWorker::cb_packet_ready_rtcp_audio_recv(GstAppSink *appsink, gpointer data)
+{
+    return static_cast<RtpWorker *>(data)->packet_ready_rtcp(appsink, false, false);
+}
+
+GstFlowReturn RtpWorker::cb_packet_ready_rtcp_video_send(GstAppSink *appsink, gpointer data)
+{
+    return static_cast<RtpWorker *>(data)->packet_ready_rtcp(appsink, true, true);
+}
+
+GstFlowReturn RtpWorker::cb_packet_ready_rtcp_video_recv(GstAppSink *appsink, gpointer data)
+{
+    return static_cast<RtpWorker *>(data)->packet_ready_rtcp(appsink, true, false);
+}
+
 GstFlowReturn RtpWorker::cb_packet_ready_preroll_stub(GstAppSink *appsink, gpointer data)
 {
     Q_UNUSED(appsink)
@@ -537,8 +944,31 @@ void RtpWorker::cb_packet_ready_eos_stub(GstAppSink *appsink, gpointer data)
     qDebug("RtpWorker::cb_packet_ready_eos_stub");
 }
 
+void RtpWorker::cb_packet_ready_eos_rtp(GstAppSink *appsink, gpointer data)
+{
+    Q_UNUSED(appsink)
+    static_cast<RtpWorker *>(data)->packet_ready_eos_rtp();
+}
+
 gboolean RtpWorker::cb_fileReady(gpointer data) { return static_cast<RtpWorker *>(data)->fileReady(); }
 
+gboolean RtpWorker::cb_fileFinished(gpointer data) { return static_cast<RtpWorker *>(data)->fileFinished(); }
+
+void RtpWorker::cb_fileFirstPassSent(void *data) { static_cast<RtpWorker *>(data)->fileFirstPassSent(); }
+
+gboolean RtpWorker::cb_fileStore(gpointer data) { return static_cast<RtpWorker *>(data)->fileStore(); }
+
+void RtpWorker::cb_fileReplayLooped(void *data) { static_cast<RtpWorker *>(data)->fileReplayLooped(); }
+
+void RtpWorker::cb_fileReplayFinished(void *data) { static_cast<RtpWorker *>(data)->fileReplayFinished(); }
+
+void RtpWorker::cb_sharedPacket(const PRtpPacket &packet, bool video, void *data)
+{
+    static_cast<RtpWorker *>(data)->sharedPacketOut(packet, video);
+}
+
+void RtpWorker::cb_shareLost(void *data) { static_cast<RtpWorker *>(data)->shareLost(); }
+
 gboolean RtpWorker::doStart()
 {
     timer = nullptr;
@@ -559,8 +989,11 @@ gboolean RtpWorker::doStart()
         if (cb_error)
             cb_error(app);
     } else {
-        // don't signal started here if using files
-        if (!fileDemux && cb_started)
+        startStatsTimer();
+
+        // don't signal started here if using files, or waiting for a
+        //   conference sender
+        if (!fileDemux && !mixCapsTimer && cb_started)
             cb_started(app);
     }
 
@@ -575,6 +1008,8 @@ gboolean RtpWorker::doUpdate()
         if (cb_error)
             cb_error(app);
     } else {
+        startStatsTimer();
+
         if (cb_updated)
             cb_updated(app);
     }
@@ -588,6 +1023,20 @@ gboolean RtpWorker::doStop()
 
     cleanup();
 
+    // a recording still going ends with the session
+    record_mutex.lock();
+    CallRecorder *r = recorder;
+    recorder        = nullptr;
+    record_mutex.unlock();
+    if (r) {
+        // let what is queued through, and the muxer write its last pages
+        r->stop();
+        bool finished = r->waitForFinished(RECORD_STOP_TIMEOUT);
+        delete r;
+        if (!finished && cb_recordData)
+            cb_recordData(QByteArray(), app);
+    }
+
     if (cb_stopped)
         cb_stopped(app);
 
@@ -617,6 +1066,7 @@ void RtpWorker::fileDemux_pad_added(GstElement *element, GstPad *pad)
     g_free(name);
 #endif
 
+    bool     linked = false;
     GstCaps *caps = gst_pad_query_caps(pad, nullptr);
 #ifdef RTPWORKER_DEBUG
     gchar * gstr       = gst_caps_to_string(caps);
@@ -636,6 +1086,14 @@ void RtpWorker::fileDemux_pad_added(GstElement *element, GstPad *pad)
         QString type    = parts[0];
         QString subtype = parts[1];
 
+        // already in a format we send, so payload it as it is
+        if (fileStreamPassesThrough(cs)) {
+            if (addPassthroughChain(pad, type == "video")) {
+                linked = true;
+                break;
+            }
+        }
+
         GstElement *decoder = nullptr;
 
         bool isAudio = false;
@@ -676,6 +1134,7 @@ void RtpWorker::fileDemux_pad_added(GstElement *element, GstPad *pad)
                 videosrc = decoder;
                 addVideoChain();
             }
+            linked = true;
 
             // decoder set up, we're done
             break;
@@ -683,6 +1142,17 @@ void RtpWorker::fileDemux_pad_added(GstElement *element, GstPad *pad)
     }
 
     gst_caps_unref(caps);
+
+    // streams we don't send don't count, for looping or for the end
+    if (!linked)
+        return;
+
+    filerecord_mutex.lock();
+    ++fileStreams;
+    filerecord_mutex.unlock();
+
+    if (fileLoop)
+        fileLoop->addStream(pad);
 }
 
 void RtpWorker::fileDemux_pad_removed(GstElement *element, GstPad *pad)
@@ -722,11 +1192,8 @@ gboolean RtpWorker::bus_call(GstBus *bus, GstMessage *msg)
         break;
     }
     case GST_MESSAGE_SEGMENT_DONE: {
-        // FIXME: we seem to get this event too often?
+        // file looping acts on the event instead, see FileLoop
         qDebug("Segment-done\n");
-        /*gst_element_seek(sendPipeline, 1, GST_FORMAT_TIME,
-                (GstSeekFlags)(GST_SEEK_FLAG_SEGMENT),
-                GST_SEEK_TYPE_SET, 0, GST_SEEK_TYPE_END, 0);*/
         break;
     }
     case GST_MESSAGE_WARNING: {
@@ -809,10 +1276,20 @@ GstFlowReturn RtpWorker::packet_ready_rtp_audio(GstAppSink *appsink)
     audioStats->print_stats(packet.rawValue.size());
 #endif
 
-    QMutexLocker locker(&rtpaudioout_mutex);
-    if (cb_rtpAudioOut && rtpaudioout)
-        cb_rtpAudioOut(packet, app);
+    {
+        QMutexLocker locker(&rtpaudioout_mutex);
+        if (cb_rtpAudioOut && rtpaudioout)
+            cb_rtpAudioOut(packet, app);
+    }
 
+    {
+        QMutexLocker locker(&record_mutex);
+        if (recorder)
+            recorder->pushAudio(true, packet.rawValue);
+    }
+
+    recordFilePacket(packet, false);
+    sendShare.fanOut(packet, false);
     return GST_FLOW_OK;
 }
 
@@ -834,24 +1311,112 @@ GstFlowReturn RtpWorker::packet_ready_rtp_video(GstAppSink *appsink)
     videoStats->print_stats(packet.rawValue.size());
 #endif
 
-    QMutexLocker locker(&rtpvideoout_mutex);
-    if (cb_rtpVideoOut && rtpvideoout)
-        cb_rtpVideoOut(packet, app);
+    {
+        QMutexLocker locker(&rtpvideoout_mutex);
+        if (cb_rtpVideoOut && rtpvideoout)
+            cb_rtpVideoOut(packet, app);
+    }
+
+    {
+        QMutexLocker locker(&record_mutex);
+        if (recorder)
+            recorder->pushVideo(true, packet.rawValue);
+    }
 
+    recordFilePacket(packet, true);
+    sendShare.fanOut(packet, true);
     return GST_FLOW_OK;
 }
 
-gboolean RtpWorker::fileReady()
+GstFlowReturn RtpWorker::packet_ready_rtcp(GstAppSink *appsink, bool video, bool sending)
 {
-    if (loopFile) {
-        // gst_element_set_state(sendPipeline, GST_STATE_PAUSED);
-        // gst_element_get_state(sendPipeline, nullptr, nullptr, GST_CLOCK_TIME_NONE);
+    GstSample *sample = gst_app_sink_pull_sample(appsink);
+    GstBuffer *buffer = gst_sample_get_buffer(sample);
+    int        sz     = int(gst_buffer_get_size(buffer));
+    QByteArray ba;
+    ba.resize(sz);
+    gst_buffer_extract(buffer, 0, ba.data(), gsize(sz));
+    gst_sample_unref(sample);
+
+    PRtpPacket packet;
+    packet.rawValue   = ba;
+    packet.portOffset = 1;
+
+    // sender reports only go out while we transmit, receiver reports
+    //   whenever we receive
+    if (video) {
+        QMutexLocker locker(&rtpvideoout_mutex);
+        if (cb_rtpVideoOut && (rtpvideoout || !sending))
+            cb_rtpVideoOut(packet, app);
+    } else {
+        QMutexLocker locker(&rtpaudioout_mutex);
+        if (cb_rtpAudioOut && (rtpaudioout || !sending))
+            cb_rtpAudioOut(packet, app);
+    }
+
+    return GST_FLOW_OK;
+}
 
-        /*gst_element_seek(sendPipeline, 1, GST_FORMAT_TIME,
-            (GstSeekFlags)(GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_SEGMENT),
-            GST_SEEK_TYPE_SET, 0, GST_SEEK_TYPE_END, 0);*/
+// watches what leaves the video jitterbuffer.  a new sender means we joined
+//   mid-stream and need a full key frame (fir), a lost packet means the
+//   picture is broken until the next one (pli).  the request goes upstream,
+//   where the session turns it into rtcp feedback for the ssrc in it.
+GstPadProbeReturn RtpWorker::video_recv_probe(GstPad *pad, GstPadProbeInfo *info)
+{
+    bool fir = false;
+    if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+        guint8 header[12];
+        if (gst_buffer_extract(GST_PAD_PROBE_INFO_BUFFER(info), 0, header, sizeof(header)) != sizeof(header))
+            return GST_PAD_PROBE_OK;
+
+        qint64 ssrc = (quint32(header[8]) << 24) | (quint32(header[9]) << 16) | (quint32(header[10]) << 8) | header[11];
+        if (ssrc == videoRecvSsrc)
+            return GST_PAD_PROBE_OK;
+
+        videoRecvSsrc = ssrc;
+        fir           = true;
+    } else {
+        GstEvent *event = GST_PAD_PROBE_INFO_EVENT(info);
+        if (GST_EVENT_TYPE(event) != GST_EVENT_CUSTOM_DOWNSTREAM || !gst_event_has_name(event, "GstRTPPacketLost"))
+            return GST_PAD_PROBE_OK;
     }
 
+    if (videoRecvSsrc == -1
+        || (keyframeRequested.isValid() && keyframeRequested.elapsed() < KEYFRAME_REQUEST_INTERVAL))
+        return GST_PAD_PROBE_OK;
+    keyframeRequested.start();
+
+#ifdef RTPWORKER_DEBUG
+    qDebug("requesting video key frame (%s)\n", fir ? "fir" : "pli");
+#endif
+
+    GstEvent *event = gst_video_event_new_upstream_force_key_unit(GST_CLOCK_TIME_NONE, fir, 0);
+    gst_structure_set(gst_event_writable_structure(event), "ssrc", G_TYPE_UINT, guint(videoRecvSsrc), nullptr);
+    gst_pad_send_event(pad, event);
+    return GST_PAD_PROBE_OK;
+}
+
+// the session passes the remote's pli/fir up to the encoder as a force key
+//   unit event.  the encoder acts on it by itself, we only keep a burst of
+//   requests from turning into a burst of key frames.
+GstPadProbeReturn RtpWorker::video_keyframe_request(GstPadProbeInfo *info)
+{
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT(info);
+    if (!gst_video_event_is_force_key_unit(event))
+        return GST_PAD_PROBE_OK;
+
+    if (keyframeForced.isValid() && keyframeForced.elapsed() < KEYFRAME_MIN_INTERVAL)
+        return GST_PAD_PROBE_DROP;
+    keyframeForced.start();
+
+#ifdef RTPWORKER_DEBUG
+    qDebug("remote requested a video key frame\n");
+#endif
+    return GST_PAD_PROBE_OK;
+}
+
+gboolean RtpWorker::fileReady()
+{
     send_pipelineContext->activate();
     gst_element_get_state(send_pipelineContext->element(), nullptr, nullptr, GST_CLOCK_TIME_NONE);
     // gst_element_set_state(sendPipeline, GST_STATE_PLAYING);
@@ -869,89 +1434,924 @@ gboolean RtpWorker::fileReady()
     return FALSE;
 }
 
-bool RtpWorker::setupSendRecv()
+// the file ended once every stream sent from it did
+void RtpWorker::packet_ready_eos_rtp()
 {
-    // FIXME:
-    // this code is not really correct, but it will suffice for our
-    //   modest purposes.  basically the way it works is:
-    //   - non-empty params indicate desire for a media type
-    //   - the only control you have over quality is maxbitrate
-    //   - input device/file indicates desire to send
-    //   - remote payloadinfo indicates desire to receive (we need this
-    //     to support theora)
-    //   - once sending or receiving is started, media types cannot
-    //     be added or removed (doing so will throw an error)
-    //   - once sending or receiving is started, codecs can't be changed
-    //     (changes will be rejected).  one exception: remote theora
-    //     config can be updated.
-    //   - once sending or receiving is started, devices can't be changed
-    //     (changes will be ignored)
+    QMutexLocker locker(&filerecord_mutex);
+    if (fileStreams == 0 || ++fileStreamsEnded < fileStreams || fileFinishedTimer)
+        return;
 
-    if (!sendbin) {
-        if (!localAudioParams.isEmpty() || !localVideoParams.isEmpty()) {
-            if (!startSend())
-                return false;
-        }
-    } else {
-        // TODO: support adding/removing audio/video to existing session
-        /*if((localAudioParams.isEmpty() != actual_localAudioPayloadInfo.isEmpty()) || (localVideoParams.isEmpty() !=
-        actual_videoPayloadInfo.isEmpty()))
-        {
-            error = RtpSessionContext::ErrorGeneric;
-            return false;
-        }*/
-    }
+    fileFinishedTimer = g_timeout_source_new(0);
+    g_source_set_callback(fileFinishedTimer, cb_fileFinished, this, nullptr);
+    g_source_attach(fileFinishedTimer, mainContext_);
+}
 
-    if (!recvbin) {
-        if ((!localAudioParams.isEmpty() && !remoteAudioPayloadInfo.isEmpty())
-            || (!localVideoParams.isEmpty() && !remoteVideoPayloadInfo.isEmpty())) {
-            if (!startRecv())
-                return false;
-        }
-    } else {
-        // TODO: support adding/removing audio/video to existing session
+gboolean RtpWorker::fileFinished()
+{
+    filerecord_mutex.lock();
+    g_source_unref(fileFinishedTimer);
+    fileFinishedTimer = nullptr;
+    filerecord_mutex.unlock();
 
-        // see if theora was updated in the remote config
-        updateTheoraConfig();
-    }
+    storeFileRecording();
 
-    // apply actual settings back to these variables, so the user can
-    //   read them
-    localAudioPayloadInfo  = actual_localAudioPayloadInfo;
-    localVideoPayloadInfo  = actual_localVideoPayloadInfo;
-    remoteAudioPayloadInfo = actual_remoteAudioPayloadInfo;
-    remoteVideoPayloadInfo = actual_remoteVideoPayloadInfo;
+    if (cb_finished)
+        cb_finished(app);
+    return FALSE;
+}
 
-    return true;
+// the file was played all the way through, keep it for next time
+void RtpWorker::storeFileRecording()
+{
+    filerecord_mutex.lock();
+    QSharedPointer<FileCacheEntry> entry = fileRecording;
+    fileRecording.clear();
+    filerecord_mutex.unlock();
+
+    if (entry && !entry->packets.isEmpty()) {
+        entry->audioPayloadInfo = localAudioPayloadInfo;
+        entry->videoPayloadInfo = localVideoPayloadInfo;
+        FileCache::insert(entry);
+    }
 }
 
-bool RtpWorker::startSend() { return startSend(16000); }
+// one pass is all the cache needs, replays loop by themselves, so once
+//   every stream is through the first one the recording is done.  streaming
+//   thread.
+void RtpWorker::fileFirstPassSent()
+{
+    QMutexLocker locker(&filerecord_mutex);
+    if (!fileRecording || fileStoreTimer)
+        return;
+
+    fileRecordDone = true;
+    fileStoreTimer = g_timeout_source_new(0);
+    g_source_set_callback(fileStoreTimer, cb_fileStore, this, nullptr);
+    g_source_attach(fileStoreTimer, mainContext_);
+}
 
-bool RtpWorker::startSend(int rate)
+gboolean RtpWorker::fileStore()
 {
-    // file source
-    if (!infile.isEmpty() || !indata.isEmpty()) {
-        if (send_in_use)
-            return false;
+    filerecord_mutex.lock();
+    g_source_unref(fileStoreTimer);
+    fileStoreTimer = nullptr;
+    filerecord_mutex.unlock();
 
-        sendbin = gst_bin_new("sendbin");
+    storeFileRecording();
+    return FALSE;
+}
 
-        GstElement *fileSource = gst_element_factory_make("filesrc", nullptr);
-        g_object_set(G_OBJECT(fileSource), "location", infile.toUtf8().data(), nullptr);
+// keep what we send from a file, with its timing, for the file cache
+void RtpWorker::recordFilePacket(const PRtpPacket &packet, bool video)
+{
+    QMutexLocker locker(&filerecord_mutex);
+    if (!fileRecording || fileRecordDone)
+        return;
+
+    // retransmissions answer one particular remote
+    if (video && videoRtxSendPt != -1 && packet.rawValue.size() >= 2
+        && (quint8(packet.rawValue[1]) & 0x7f) == videoRtxSendPt)
+        return;
+
+    if (!fileRecordClock.isValid())
+        fileRecordClock.start();
+
+    FileCacheEntry::Packet p;
+    p.timeUs = fileRecordClock.nsecsElapsed() / 1000;
+    p.video  = video;
+    p.data   = packet.rawValue;
+    fileRecording->packets += p;
+    fileRecording->bytes += p.data.size();
+
+    if (fileRecording->bytes > FileCache::maxEntryBytes())
+        fileRecording.clear(); // too big to cache
+}
 
-        fileDemux = gst_element_factory_make("oggdemux", nullptr);
-        g_signal_connect(G_OBJECT(fileDemux), "no-more-pads", G_CALLBACK(cb_fileDemux_no_more_pads), this);
-        g_signal_connect(G_OBJECT(fileDemux), "pad-added", G_CALLBACK(cb_fileDemux_pad_added), this);
-        g_signal_connect(G_OBJECT(fileDemux), "pad-removed", G_CALLBACK(cb_fileDemux_pad_removed), this);
+// send a cached file in place of playing it, through the same rewriting as
+//   shared encoders, so the stream is our own
+bool RtpWorker::startFileReplay(const QSharedPointer<const FileCacheEntry> &entry)
+{
+#ifdef RTPWORKER_DEBUG
+    qDebug("playing the file from the cache\n");
+#endif
+    rtpaudioout_mutex.lock();
+    shareAudio.reset(entry->audioPayloadInfo, remoteAudioPayloadInfo, 48000, audioSsrc);
+    rtpaudioout_mutex.unlock();
+
+    rtpvideoout_mutex.lock();
+    shareVideo.reset(entry->videoPayloadInfo, remoteVideoPayloadInfo, 90000, videoSsrc);
+    rtpvideoout_mutex.unlock();
+
+    localAudioPayloadInfo        = entry->audioPayloadInfo;
+    localVideoPayloadInfo        = entry->videoPayloadInfo;
+    actual_localAudioPayloadInfo = localAudioPayloadInfo;
+    actual_localVideoPayloadInfo = localVideoPayloadInfo;
+    canTransmitAudio             = !localAudioPayloadInfo.isEmpty();
+    canTransmitVideo             = !localVideoPayloadInfo.isEmpty();
+
+    fileReplay              = new FileReplay(entry, loopFile, mainContext_);
+    fileReplay->app         = this;
+    fileReplay->cb_packet   = cb_sharedPacket;
+    fileReplay->cb_looped   = cb_fileReplayLooped;
+    fileReplay->cb_finished = cb_fileReplayFinished;
+    fileReplay->start();
+    return true;
+}
+
+// start over, the rewriters carry the sequence numbers and timestamps on
+//   from where they were
+void RtpWorker::fileReplayLooped()
+{
+    rtpaudioout_mutex.lock();
+    shareAudio.resync();
+    rtpaudioout_mutex.unlock();
+
+    rtpvideoout_mutex.lock();
+    shareVideo.resync();
+    rtpvideoout_mutex.unlock();
+}
+
+void RtpWorker::fileReplayFinished()
+{
+    if (cb_finished)
+        cb_finished(app);
+}
+
+// calls func with the stats structure of every source the session knows
+template <typename F> static void session_foreach_source(GstElement *session, F func)
+{
+    if (!session)
+        return;
+
+    GstStructure *stats = nullptr;
+    g_object_get(G_OBJECT(session), "stats", &stats, nullptr);
+    if (!stats)
+        return;
+
+    // rtpsession hands these out as a GValueArray, nothing to do about it
+    G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+    const GValue *value   = gst_structure_get_value(stats, "source-stats");
+    GValueArray * sources = value ? static_cast<GValueArray *>(g_value_get_boxed(value)) : nullptr;
+    for (guint n = 0; sources && n < sources->n_values; ++n) {
+        const GstStructure *s = gst_value_get_structure(g_value_array_get_nth(sources, n));
+        if (s)
+            func(s);
+    }
+    G_GNUC_END_IGNORE_DEPRECATIONS
+
+    gst_structure_free(stats);
+}
+
+static RtpWorker::NetworkStats session_network_stats(GstElement *sendSession, GstElement *recvSession)
+{
+    RtpWorker::NetworkStats out;
+
+    // what the remote says about our stream, from its receiver reports.
+    //   jitter in those is in units of our clock rate.
+    int    clockRate = 0;
+    qint64 rbJitter  = -1;
+    session_foreach_source(sendSession, [&](const GstStructure *s) {
+        gboolean internal = FALSE;
+        gst_structure_get_boolean(s, "internal", &internal);
+        if (internal) {
+            int rate;
+            if (gst_structure_get_int(s, "clock-rate", &rate) && rate > 0)
+                clockRate = rate;
+            return;
+        }
+
+        gboolean haveRb = FALSE;
+        if (!gst_structure_get_boolean(s, "have-rb", &haveRb) || !haveRb)
+            return;
+
+        guint fractionLost = 0, jitter = 0, lsr = 0, roundTrip = 0;
+        gst_structure_get_uint(s, "rb-fractionlost", &fractionLost);
+        gst_structure_get_uint(s, "rb-jitter", &jitter);
+        gst_structure_get_uint(s, "rb-lsr", &lsr);
+        gst_structure_get_uint(s, "rb-round-trip", &roundTrip);
+
+        guint highestSeq;
+        if (gst_structure_get_uint(s, "rb-exthighestseq", &highestSeq))
+            out.sendReportSeq = highestSeq;
+
+        out.sendLoss = double(fractionLost) / 256;
+        rbJitter     = jitter;
+
+        // no round trip can be known until the remote has seen one of
+        //   our sender reports.  the value is in 1/65536 seconds.
+        if (lsr != 0)
+            out.roundTripMs = int(quint64(roundTrip) * 1000 / 65536);
+    });
+    if (rbJitter >= 0 && clockRate > 0)
+        out.sendJitterMs = int(rbJitter * 1000 / clockRate);
+
+    // what we see of the remote's stream
+    session_foreach_source(recvSession, [&](const GstStructure *s) {
+        gboolean internal = FALSE, isSender = FALSE;
+        gst_structure_get_boolean(s, "internal", &internal);
+        gst_structure_get_boolean(s, "is-sender", &isSender);
+        if (internal || !isSender)
+            return;
+
+        guint jitter;
+        int   rate, lost;
+        if (gst_structure_get_uint(s, "jitter", &jitter) && gst_structure_get_int(s, "clock-rate", &rate) && rate > 0)
+            out.recvJitterMs = int(quint64(jitter) * 1000 / quint64(rate));
+        if (gst_structure_get_int(s, "packets-lost", &lost))
+            out.recvLost = qMax(lost, 0);
+    });
+
+    return out;
+}
+
+// returns the controller for the named jitterbuffer in a decoder bin, or null
+//   if there is none.  the jitterbuffer is borrowed, the bin keeps it alive.
+static LatencyController *latency_controller_for(GstElement *dec, GstElement **jitterbuffer)
+{
+    *jitterbuffer = gst_bin_get_by_name(GST_BIN(dec), "jitterbuffer");
+    if (!*jitterbuffer)
+        return nullptr;
+    gst_object_unref(*jitterbuffer);
+
+    guint latency = 0;
+    g_object_get(G_OBJECT(*jitterbuffer), "latency", &latency, nullptr);
+    return new LatencyController(int(latency));
+}
+
+// resize the jitterbuffer from the jitter and late packets seen since the
+//   last call, and fill in the receive latency stats
+static void adapt_latency(LatencyController *ctl, GstElement *jitterbuffer, RtpWorker::NetworkStats *stats,
+                          const char *name)
+{
+    GstStructure *jbstats = nullptr;
+    g_object_get(G_OBJECT(jitterbuffer), "stats", &jbstats, nullptr);
+    if (!jbstats)
+        return;
+
+    guint64 pushed = 0, late = 0;
+    gst_structure_get_uint64(jbstats, "num-pushed", &pushed);
+    gst_structure_get_uint64(jbstats, "num-late", &late);
+    gst_structure_free(jbstats);
+
+    if (ctl->update(stats->recvJitterMs, pushed, late)) {
+#ifdef RTPWORKER_DEBUG
+        qDebug("%s latency: jitter=%d late=%.3f -> %d ms\n", name, stats->recvJitterMs, ctl->lateRate(),
+               ctl->latencyMs());
+#else
+        Q_UNUSED(name);
+#endif
+        g_object_set(G_OBJECT(jitterbuffer), "latency", guint(ctl->latencyMs()), nullptr);
+
+        // the sinks have to learn about it too.  that's the receive
+        //   pipeline, or the mixer's for a conference.
+        GstElement *pipeline = jitterbuffer;
+        while (GST_ELEMENT_PARENT(pipeline))
+            pipeline = GST_ELEMENT_PARENT(pipeline);
+        if (GST_IS_BIN(pipeline))
+            gst_bin_recalculate_latency(GST_BIN(pipeline));
+    }
+
+    stats->recvLatencyMs = ctl->latencyMs();
+    stats->recvLateRate  = ctl->lateRate();
+}
+
+gboolean RtpWorker::doStats()
+{
+    NetworkStats audio = session_network_stats(audiosendsession, audiorecvsession);
+    NetworkStats video = session_network_stats(videosendsession, videorecvsession);
+
+    if (audioLatency)
+        adapt_latency(audioLatency, audiojitterbuffer, &audio, "audio");
+
+    // size the opus fec data for the loss the remote actually sees
+    if (audioencoder && audioEncParams.fec && audio.sendLoss >= 0) {
+        int percent = qBound(qMax(audioEncParams.packetLoss, 1), int(audio.sendLoss * 100 + 0.5), 100);
+        if (percent != audioLossPercent) {
+            audioLossPercent = percent;
+            g_object_set(G_OBJECT(audioencoder), "packet-loss-percentage", percent, nullptr);
+        }
+    }
+    if (videoLatency)
+        adapt_latency(videoLatency, videojitterbuffer, &video, "video");
+
+    // adapt to each new receiver report about our video
+    if (videoBitrate && video.sendReportSeq != -1 && video.sendReportSeq != videoReportSeq) {
+        videoReportSeq = video.sendReportSeq;
+        if (videoBitrate->update(video.sendLoss, video.roundTripMs)) {
+#ifdef RTPWORKER_DEBUG
+            qDebug("video rate: loss=%.2f rtt=%d -> %d kbps, %d fps\n", video.sendLoss, video.roundTripMs,
+                   videoBitrate->kbps(), videoBitrate->fps());
+#endif
+            if (videoencoder)
+                g_object_set(G_OBJECT(videoencoder), "bitrate", videoBitrate->kbps(), nullptr);
+            if (videopreprate)
+                g_object_set(G_OBJECT(videopreprate), "max-rate", videoBitrate->fps(), nullptr);
+        }
+    }
+
+    QMutexLocker locker(&netstats_mutex);
+    audioNetStats = audio;
+    videoNetStats = video;
+    return TRUE;
+}
+
+void RtpWorker::startStatsTimer()
+{
+    if (statsTimer || (!sendbin && !recvbin))
+        return;
+
+    statsTimer = g_timeout_source_new(STATS_INTERVAL);
+    g_source_set_callback(statsTimer, cb_doStats, this, nullptr);
+    g_source_attach(statsTimer, mainContext_);
+}
+
+// payload type of the rtx stream for payload type pt, as in "a=fmtp:<rtx>
+//   apt=<pt>".  -1 if there is none.
+static int rtx_payload_type(const QList<PPayloadInfo> &list, int pt)
+{
+    for (const PPayloadInfo &pi : list) {
+        if (pi.name.toLower() != "rtx")
+            continue;
+        for (const PPayloadInfo::Parameter &param : pi.parameters) {
+            if (param.name == "apt" && param.value.toInt() == pt)
+                return pi.id;
+        }
+    }
+    return -1;
+}
+
+// a dynamic payload type nobody in the list uses, other than pt
+static int unused_payload_type(const QList<PPayloadInfo> &list, int pt)
+{
+    for (int id = 96; id < 128; ++id) {
+        bool used = (id == pt);
+        for (const PPayloadInfo &pi : list)
+            used = used || pi.id == id;
+        if (!used)
+            return id;
+    }
+    return -1;
+}
+
+// payload type of the named payloader inside an encoder bin, or of the
+//   element itself if it isn't a bin, -1 if not found
+static int payloader_payload_type(GstElement *bin, const char *name)
+{
+    GstElement *payloader
+        = GST_IS_BIN(bin) ? gst_bin_get_by_name(GST_BIN(bin), name) : GST_ELEMENT(gst_object_ref(bin));
+    if (!payloader)
+        return -1;
+    guint pt = 0;
+    g_object_get(G_OBJECT(payloader), "pt", &pt, nullptr);
+    gst_object_unref(payloader);
+    return int(pt);
+}
+
+// the send and receive sessions of a media live in different pipelines,
+//   so they can't be one element.  give both the ssrc our rtp goes out
+//   with, so the peer sees our receiver reports and sender reports coming
+//   from the same source.
+static void session_set_ssrc(GstElement *session, quint32 ssrc)
+{
+    GObject *internal = nullptr;
+    g_object_get(G_OBJECT(session), "internal-session", &internal, nullptr);
+    if (!internal)
+        return;
+    g_object_set(internal, "internal-ssrc", guint(ssrc), nullptr);
+    g_object_unref(internal);
+}
+
+// same for the payloader named name inside an encoder bin, or the element
+//   itself if it isn't a bin
+static void payloader_set_ssrc(GstElement *bin, const char *name, quint32 ssrc)
+{
+    GstElement *payloader
+        = GST_IS_BIN(bin) ? gst_bin_get_by_name(GST_BIN(bin), name) : GST_ELEMENT(gst_object_ref(bin));
+    if (!payloader)
+        return;
+    g_object_set(G_OBJECT(payloader), "ssrc", guint(ssrc), nullptr);
+    gst_object_unref(payloader);
+}
+
+static GstStructure *rtx_payload_type_map(int from, int to)
+{
+    return gst_structure_new("application/x-rtp-pt-map", QByteArray::number(from).data(), G_TYPE_UINT, guint(to),
+                             nullptr);
+}
+
+// retransmission cache for what the video payloader in pay sends.  the
+//   remote's rtx payload type is used if it offered one, else we pick one
+//   and announce it through getCaps().
+GstElement *RtpWorker::makeRtxSend(GstElement *pay)
+{
+    int pt = payloader_payload_type(pay, "video-payloader");
+    if (pt == -1)
+        return nullptr;
+
+    int rtxPt = rtx_payload_type(remoteVideoPayloadInfo, pt);
+    if (rtxPt == -1)
+        rtxPt = unused_payload_type(remoteVideoPayloadInfo, pt);
+    if (rtxPt == -1)
+        return nullptr;
+
+    GstElement *rtxsend = gst_element_factory_make("rtprtxsend", nullptr);
+    if (!rtxsend)
+        return nullptr;
+
+    GstStructure *map = rtx_payload_type_map(pt, rtxPt);
+    g_object_set(G_OBJECT(rtxsend), "payload-type-map", map, "max-size-time", guint(RTX_CACHE_TIME),
+                 "max-size-packets", guint(RTX_CACHE_PACKETS), nullptr);
+    gst_structure_free(map);
+
+    videoRtxSendPt = rtxPt;
+    return rtxsend;
+}
+
+// the session sits between the payloader and the rtp appsink.  it sends
+//   sender reports through its own appsink and learns about the remote's
+//   reception from the rtcp we push into its appsrc.  if rtpsession isn't
+//   available we just go without rtcp.
+GstElement *RtpWorker::addSendSession(GstElement *pay, GstElement *rtpsink, bool video)
+{
+    payloader_set_ssrc(pay, video ? "video-payloader" : "audio-payloader", video ? videoSsrc : audioSsrc);
+
+    GstElement *session = gst_element_factory_make("rtpsession", nullptr);
+    if (!session) {
+        gst_element_link(pay, rtpsink);
+        return nullptr;
+    }
+    session_set_ssrc(session, video ? videoSsrc : audioSsrc);
+
+    GstElement *rtcpsrc = gst_element_factory_make("appsrc", nullptr);
+    GstCaps *   caps    = gst_caps_new_empty_simple("application/x-rtcp");
+    g_object_set(G_OBJECT(rtcpsrc), "caps", caps, "format", GST_FORMAT_TIME, nullptr);
+    gst_caps_unref(caps);
+
+    // rtcp goes out on the session's own schedule, so the sink must neither
+    //   sync nor hold up preroll
+    GstElement *rtcpsink = gst_element_factory_make("appsink", nullptr);
+    g_object_set(G_OBJECT(rtcpsink), "sync", FALSE, "async", FALSE, nullptr);
+
+    GstAppSinkCallbacks sinkCb = {};
+    sinkCb.new_sample          = video ? cb_packet_ready_rtcp_video_send : cb_packet_ready_rtcp_audio_send;
+    sinkCb.eos                 = cb_packet_ready_eos_stub;
+    sinkCb.new_preroll         = cb_packet_ready_preroll_stub;
+    gst_app_sink_set_callbacks(reinterpret_cast<GstAppSink *>(rtcpsink), &sinkCb, this, nullptr);
+
+    // the session answers nacks by asking upstream for the packets again,
+    //   so the retransmission cache goes between payloader and session
+    GstElement *rtxsend = video ? makeRtxSend(pay) : nullptr;
+
+    gst_bin_add(GST_BIN(sendbin), session);
+    gst_bin_add(GST_BIN(sendbin), rtcpsrc);
+    gst_bin_add(GST_BIN(sendbin), rtcpsink);
+
+    if (rtxsend) {
+        gst_bin_add(GST_BIN(sendbin), rtxsend);
+        gst_element_link(pay, rtxsend);
+        gst_element_link_pads(rtxsend, "src", session, "send_rtp_sink");
+        gst_util_set_object_arg(G_OBJECT(session), "rtp-profile", "avpf");
+    } else
+        gst_element_link_pads(pay, "src", session, "send_rtp_sink");
+    gst_element_link_pads(session, "send_rtp_src", rtpsink, "sink");
+    gst_element_link_pads(session, "send_rtcp_src", rtcpsink, "sink");
+    gst_element_link_pads(rtcpsrc, "src", session, "recv_rtcp_sink");
+
+    if (fileDemux) {
+        gst_element_sync_state_with_parent(session);
+        gst_element_sync_state_with_parent(rtcpsrc);
+        gst_element_sync_state_with_parent(rtcpsink);
+        if (rtxsend)
+            gst_element_sync_state_with_parent(rtxsend);
+    }
+
+    if (video) {
+        videosendsession = session;
+        QMutexLocker locker(&videortcpsrc_mutex);
+        videosendrtcpsrc = rtcpsrc;
+    } else {
+        audiosendsession = session;
+        QMutexLocker locker(&audiortcpsrc_mutex);
+        audiosendrtcpsrc = rtcpsrc;
+    }
+
+    return session;
+}
+
+// same as above for the receiving side: the session sits between the rtp
+//   appsrc and the decoder and sends receiver reports
+GstElement *RtpWorker::addRecvSession(GstElement *rtpsrc, GstElement *dec, bool video)
+{
+    GstElement *session = gst_element_factory_make("rtpsession", nullptr);
+    if (!session) {
+        gst_element_link(rtpsrc, dec);
+        return nullptr;
+    }
+    session_set_ssrc(session, video ? videoSsrc : audioSsrc);
+
+    GstElement *rtcpsrc = gst_element_factory_make("appsrc", nullptr);
+    GstCaps *   caps    = gst_caps_new_empty_simple("application/x-rtcp");
+    g_object_set(G_OBJECT(rtcpsrc), "caps", caps, "format", GST_FORMAT_TIME, nullptr);
+    gst_caps_unref(caps);
+
+    GstElement *rtcpsink = gst_element_factory_make("appsink", nullptr);
+    g_object_set(G_OBJECT(rtcpsink), "sync", FALSE, "async", FALSE, nullptr);
+
+    GstAppSinkCallbacks sinkCb = {};
+    sinkCb.new_sample          = video ? cb_packet_ready_rtcp_video_recv : cb_packet_ready_rtcp_audio_recv;
+    sinkCb.eos                 = cb_packet_ready_eos_stub;
+    sinkCb.new_preroll         = cb_packet_ready_preroll_stub;
+    gst_app_sink_set_callbacks(reinterpret_cast<GstAppSink *>(rtcpsink), &sinkCb, this, nullptr);
+
+    gst_bin_add(GST_BIN(recvbin), session);
+    gst_bin_add(GST_BIN(recvbin), rtcpsrc);
+    gst_bin_add(GST_BIN(recvbin), rtcpsink);
+
+    gst_element_link_pads(rtpsrc, "src", session, "recv_rtp_sink");
+    gst_element_link_pads(session, "recv_rtp_src", dec, "sink");
+    gst_element_link_pads(session, "send_rtcp_src", rtcpsink, "sink");
+    gst_element_link_pads(rtcpsrc, "src", session, "recv_rtcp_sink");
+
+    if (video) {
+        videorecvsession = session;
+        QMutexLocker locker(&videortcpsrc_mutex);
+        videorecvrtcpsrc = rtcpsrc;
+    } else {
+        audiorecvsession = session;
+        QMutexLocker locker(&audiortcpsrc_mutex);
+        audiorecvrtcpsrc = rtcpsrc;
+    }
+
+    return session;
+}
+
+bool RtpWorker::setupSendRecv()
+{
+    // FIXME:
+    // this code is not really correct, but it will suffice for our
+    //   modest purposes.  basically the way it works is:
+    //   - non-empty params indicate desire for a media type
+    //   - the only control you have over quality is maxbitrate
+    //   - input device/file indicates desire to send
+    //   - remote payloadinfo indicates desire to receive (we need this
+    //     to support theora)
+    //   - once sending or receiving is started, media types cannot
+    //     be added or removed (doing so will throw an error)
+    //   - once sending or receiving is started, codecs can't be changed
+    //     (changes will be rejected).  one exception: remote theora
+    //     config can be updated.
+    //   - once sending or receiving is started, devices can be switched
+    //     but not added or removed (such changes will be ignored)
+
+    // a session taking another's packets has no sender of its own
+    bool subscribed = sendShare.isSubscriber();
+
+    if (!sendbin && !subscribed && !fileReplay) {
+        if (!localAudioParams.isEmpty() || !localVideoParams.isEmpty()) {
+            if (!startSend())
+                return false;
+        }
+    } else {
+        // TODO: support adding/removing audio/video to existing session
+        /*if((localAudioParams.isEmpty() != actual_localAudioPayloadInfo.isEmpty()) || (localVideoParams.isEmpty() !=
+        actual_videoPayloadInfo.isEmpty()))
+        {
+            error = RtpSessionContext::ErrorGeneric;
+            return false;
+        }*/
+    }
+
+    // it may have just joined
+    subscribed = sendShare.isSubscriber();
+
+    if (!recvbin) {
+        if ((!localAudioParams.isEmpty() && !remoteAudioPayloadInfo.isEmpty())
+            || (!localVideoParams.isEmpty() && !remoteVideoPayloadInfo.isEmpty())) {
+            // and it is send-only: the receiving side isn't shared, and the
+            //   owner already has it.  say so instead of silently not
+            //   playing what the remote sends.
+            if (subscribed) {
+#ifdef RTPWORKER_DEBUG
+                qDebug("sessions sharing encoders can't receive\n");
+#endif
+                error = RtpSessionContext::ErrorGeneric;
+                return false;
+            }
+            if (!startRecv())
+                return false;
+        }
+    } else {
+        // TODO: support adding/removing audio/video to existing session
+
+        // see if theora was updated in the remote config
+        updateTheoraConfig();
+    }
+
+    switchDevices();
+
+    // apply actual settings back to these variables, so the user can
+    //   read them
+    localAudioPayloadInfo  = actual_localAudioPayloadInfo;
+    localVideoPayloadInfo  = actual_localVideoPayloadInfo;
+    remoteAudioPayloadInfo = actual_remoteAudioPayloadInfo;
+    remoteVideoPayloadInfo = actual_remoteVideoPayloadInfo;
+
+    return true;
+}
+
+// sessions sending from the same devices with the same settings, to peers
+//   that asked for the same opus options, would encode the same thing
+static QString send_share_key(const QString &ain, const QString &vin, int maxbitrate,
+                              const QList<PAudioParams> &audioParams, const QList<PVideoParams> &videoParams,
+                              const QList<PPayloadInfo> &remoteAudioPayloadInfo)
+{
+    QStringList parts;
+    parts << ain << vin << QString::number(maxbitrate);
+    for (const PAudioParams &p : audioParams)
+        parts << QString("a:%1/%2/%3/%4/%5/%6/%7/%8/%9/%10")
+                     .arg(p.codec)
+                     .arg(p.sampleRate)
+                     .arg(p.sampleSize)
+                     .arg(p.channels)
+                     .arg(p.ptime)
+                     .arg(p.bitrate)
+                     .arg(p.complexity)
+                     .arg(p.packetLoss)
+                     .arg(p.fec)
+                     .arg(p.dtx);
+    for (const PVideoParams &p : videoParams)
+        parts << QString("v:%1/%2x%3/%4").arg(p.codec).arg(p.size.width()).arg(p.size.height()).arg(p.fps);
+
+    int opus_at = opus_payload_at(remoteAudioPayloadInfo);
+    if (opus_at != -1) {
+        QStringList fmtp;
+        for (const PPayloadInfo::Parameter &p : remoteAudioPayloadInfo[opus_at].parameters)
+            fmtp << p.name + '=' + p.value;
+        fmtp.sort();
+        parts << QString("o:%1/").arg(remoteAudioPayloadInfo[opus_at].clockrate) + fmtp.join(';');
+    }
+
+    return parts.join('\n');
+}
+
+// take the packets of a session already sending what we would, if any
+bool RtpWorker::joinSendShare()
+{
+    QString key = send_share_key(ain, vin, maxbitrate, localAudioParams, localVideoParams, remoteAudioPayloadInfo);
+
+    QList<PPayloadInfo> audioPayloadInfo, videoPayloadInfo;
+    if (!sendShare.join(key, &audioPayloadInfo, &videoPayloadInfo))
+        return false;
+
+#ifdef RTPWORKER_DEBUG
+    qDebug("sharing the encoders of another session\n");
+#endif
+    // our own ssrc, and the payload types our remote expects
+    rtpaudioout_mutex.lock();
+    shareAudio.reset(audioPayloadInfo, remoteAudioPayloadInfo, 48000, audioSsrc);
+    rtpaudioout_mutex.unlock();
+
+    rtpvideoout_mutex.lock();
+    shareVideo.reset(videoPayloadInfo, remoteVideoPayloadInfo, 90000, videoSsrc);
+    rtpvideoout_mutex.unlock();
+
+    localAudioPayloadInfo        = audioPayloadInfo;
+    localVideoPayloadInfo        = videoPayloadInfo;
+    actual_localAudioPayloadInfo = localAudioPayloadInfo;
+    actual_localVideoPayloadInfo = localVideoPayloadInfo;
+    canTransmitAudio             = !localAudioPayloadInfo.isEmpty();
+    canTransmitVideo             = !localVideoPayloadInfo.isEmpty();
+    return true;
+}
+
+void RtpWorker::shareLost()
+{
+    // the first subscriber to get here takes over the devices, and the
+    //   others share its encoders in turn
+#ifdef RTPWORKER_DEBUG
+    qDebug("shared encoders went away, sending on our own\n");
+#endif
+    if (!startSend()) {
+        if (cb_error)
+            cb_error(app);
+    }
+}
+
+// packets encoded elsewhere, by the encoders we share or from the file
+//   cache, sent as our own
+void RtpWorker::sharedPacketOut(const PRtpPacket &packet, bool video)
+{
+    PRtpPacket out = packet;
+    PRtpPacket report;
+    report.portOffset = 1;
+    if (video) {
+        QMutexLocker locker(&rtpvideoout_mutex);
+        if (!shareVideo.rewrite(&out.rawValue, shareCname, &report.rawValue))
+            return;
+        if (cb_rtpVideoOut && rtpvideoout) {
+            cb_rtpVideoOut(out, app);
+            if (!report.rawValue.isEmpty())
+                cb_rtpVideoOut(report, app);
+        }
+    } else {
+        QMutexLocker locker(&rtpaudioout_mutex);
+        if (!shareAudio.rewrite(&out.rawValue, shareCname, &report.rawValue))
+            return;
+        if (cb_rtpAudioOut && rtpaudioout) {
+            cb_rtpAudioOut(out, app);
+            if (!report.rawValue.isEmpty())
+                cb_rtpAudioOut(report, app);
+        }
+    }
+
+    QMutexLocker locker(&record_mutex);
+    if (recorder && video)
+        recorder->pushVideo(true, out.rawValue);
+    else if (recorder)
+        recorder->pushAudio(true, out.rawValue);
+}
+
+// devices changed while the session runs are switched without stopping it
+void RtpWorker::switchDevices()
+{
+    auto pending = [this](PDevice::Type type) {
+        for (DeviceSwap *swap : deviceSwaps) {
+            if (swap->type() == type)
+                return true;
+        }
+        return false;
+    };
+
+    if (sendbin) {
+        if (pd_audiosrc && !ain.isEmpty() && !MixerParticipant::isMixerDevice(ain) && ain != pd_audiosrc->id()
+            && !pending(PDevice::AudioIn))
+            startDeviceSwap(PDevice::AudioIn, ain);
+        if (pd_videosrc && !vin.isEmpty() && vin != pd_videosrc->id() && !pending(PDevice::VideoIn))
+            startDeviceSwap(PDevice::VideoIn, vin);
+    }
+
+    if (recvbin) {
+        if (pd_audiosink && !aout.isEmpty() && !MixerParticipant::isMixerDevice(aout) && aout != pd_audiosink->id()
+            && !pending(PDevice::AudioOut))
+            startDeviceSwap(PDevice::AudioOut, aout);
+    }
+}
+
+bool RtpWorker::startDeviceSwap(PDevice::Type type, const QString &id)
+{
+    PipelineContext *      pipeline = send_pipelineContext;
+    PipelineDeviceContext *from;
+    PipelineDeviceOptions  opts;
+    if (type == PDevice::AudioOut) {
+        // an echo canceller on the input follows, see finishDeviceSwap()
+        pipeline = recv_pipelineContext;
+        from     = pd_audiosink;
+    } else if (type == PDevice::AudioIn) {
+        from = pd_audiosrc;
+        if (pd_audiosink != nullptr) {
+            opts     = pd_audiosink->options();
+            opts.aec = !opts.echoProberName.isEmpty();
+        }
+    } else {
+        from = pd_videosrc;
+        opts = pd_videosrc->options();
+    }
+
+    DeviceSwap *swap  = new DeviceSwap(type, from, mainContext_);
+    swap->app         = this;
+    swap->cb_switched = cb_deviceSwapped;
+    if (!swap->start(pipeline, id, opts)) {
+#ifdef RTPWORKER_DEBUG
+        qDebug("Failed to start device '%s' to switch to.\n", qPrintable(id));
+#endif
+        swap->finish();
+        return false;
+    }
+    deviceSwaps += swap;
+
+#ifdef RTPWORKER_DEBUG
+    qDebug("switching to device '%s'\n", qPrintable(id));
+#endif
+    return true;
+}
+
+void RtpWorker::deviceSwapped(DeviceSwap *swap)
+{
+    deviceSwaps.removeAll(swap);
+    finishDeviceSwap(swap);
+
+    // the device may have been changed again meanwhile
+    switchDevices();
+}
+
+// takes the new device, if it took over
+void RtpWorker::finishDeviceSwap(DeviceSwap *swap)
+{
+    PDevice::Type          type   = swap->type();
+    PipelineDeviceContext *device = swap->finish();
+
+    switch (type) {
+    case PDevice::AudioIn:
+        if (device == pd_audiosrc)
+            return;
+        pd_audiosrc = device;
+        audiosrc    = pd_audiosrc->element();
+        break;
+    case PDevice::VideoIn:
+        if (device == pd_videosrc)
+            return;
+        pd_videosrc = device;
+        videosrc    = pd_videosrc->element();
+        break;
+    case PDevice::AudioOut:
+        if (device == pd_audiosink)
+            return;
+        pd_audiosink = device;
+
+        // the echo canceller has to listen to the new output
+        if (pd_audiosrc && pd_audiosrc->options().aec) {
+            PipelineDeviceOptions opts = pd_audiosrc->options();
+            opts.echoProberName        = pd_audiosink->options().echoProberName;
+            pd_audiosrc->setOptions(opts);
+        }
+        break;
+    }
+
+#ifdef RTPWORKER_DEBUG
+    qDebug("switched to device '%s'\n", qPrintable(device->id()));
+#endif
+
+    // sessions wanting the devices we send from now can take our packets
+    if (type != PDevice::AudioOut) {
+        QString a = pd_audiosrc ? pd_audiosrc->id() : ain;
+        QString v = pd_videosrc ? pd_videosrc->id() : vin;
+        sendShare.setKey(
+            send_share_key(a, v, maxbitrate, localAudioParams, localVideoParams, remoteAudioPayloadInfo));
+    }
+}
+
+bool RtpWorker::startSend()
+{
+    // conference mix
+    if (MixerParticipant::isMixerDevice(ain))
+        return startMixSend();
+
+    // file source
+    if (!infile.isEmpty() || !indata.isEmpty()) {
+        // if the file was sent with the same settings before, send that again
+        QString cacheKey = FileCache::fileKey(infile, indata);
+        if (!cacheKey.isEmpty()) {
+            cacheKey += '\n'
+                + send_share_key(QString(), QString(), maxbitrate, localAudioParams, localVideoParams,
+                                 remoteAudioPayloadInfo);
+            QSharedPointer<const FileCacheEntry> entry = FileCache::find(cacheKey);
+            if (entry)
+                return startFileReplay(entry);
+        }
+
+        if (send_in_use)
+            return false;
+
+        sendbin = gst_bin_new("sendbin");
+
+        GstElement *fileSource = nullptr;
+        if (!infile.isEmpty()) {
+            fileSource = make_mapped_file_source(infile);
+            if (!fileSource) {
+                fileSource = gst_element_factory_make("filesrc", nullptr);
+                g_object_set(G_OBJECT(fileSource), "location", infile.toUtf8().data(), nullptr);
+            }
+        } else {
+            fileSource = make_memory_source(indata);
+        }
+
+        if (!cacheKey.isEmpty()) {
+            QMutexLocker locker(&filerecord_mutex);
+            fileRecording      = QSharedPointer<FileCacheEntry>::create();
+            fileRecording->key = cacheKey;
+            fileRecordClock.invalidate();
+        }
+
+        fileDemux = gst_element_factory_make("oggdemux", nullptr);
+        g_signal_connect(G_OBJECT(fileDemux), "no-more-pads", G_CALLBACK(cb_fileDemux_no_more_pads), this);
+        g_signal_connect(G_OBJECT(fileDemux), "pad-added", G_CALLBACK(cb_fileDemux_pad_added), this);
+        g_signal_connect(G_OBJECT(fileDemux), "pad-removed", G_CALLBACK(cb_fileDemux_pad_removed), this);
 
         gst_bin_add(GST_BIN(sendbin), fileSource);
         gst_bin_add(GST_BIN(sendbin), fileDemux);
         gst_element_link(fileSource, fileDemux);
+
+        if (loopFile) {
+            fileLoop                   = new FileLoop(fileDemux, mainContext_);
+            fileLoop->app              = this;
+            fileLoop->cb_firstPassSent = cb_fileFirstPassSent;
+        }
     }
     // device source
     else if (!ain.isEmpty() || !vin.isEmpty()) {
+        // the devices are taken, but perhaps by a session sending the same
         if (send_in_use)
-            return false;
+            return joinSendShare();
 
         sendbin = gst_bin_new("sendbin");
 
@@ -978,9 +2378,7 @@ bool RtpWorker::startSend(int rate)
 
         if (!vin.isEmpty() && !localVideoParams.isEmpty()) {
             PipelineDeviceOptions opts;
-            // opts.videoSize = localVideoParams[0].size;
-            opts.videoSize = QSize(640, 480);
-            opts.fps       = 30;
+            video_params_for_send(localVideoParams, maxbitrate, &opts.videoSize, &opts.fps);
 
             pd_videosrc = PipelineDeviceContext::create(send_pipelineContext, vin, PDevice::VideoIn, opts);
             if (!pd_videosrc) {
@@ -1007,7 +2405,7 @@ bool RtpWorker::startSend(int rate)
     send_in_use = true;
 
     if (audiosrc) {
-        if (!addAudioChain(rate)) {
+        if (!addAudioChain()) {
             delete pd_audiosrc;
             pd_audiosrc = nullptr;
             delete pd_videosrc;
@@ -1042,12 +2440,10 @@ bool RtpWorker::startSend(int rate)
         // gst_element_set_state(sendbin, GST_STATE_PAUSED);
         // gst_element_get_state(sendbin, nullptr, nullptr, GST_CLOCK_TIME_NONE);
 
-        /*if(loopFile)
-        {
-            gst_element_seek(sendPipeline, 1, GST_FORMAT_TIME,
-                (GstSeekFlags)(GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_SEGMENT),
-                GST_SEEK_TYPE_SET, 0, GST_SEEK_TYPE_END, 0);
-        }*/
+        if (fileLoop) {
+            fileLoop->start();
+            gst_element_get_state(spipeline, nullptr, nullptr, GST_CLOCK_TIME_NONE);
+        }
     } else {
         // in the case of live transmission, wait for it to start and signal
         // gst_element_set_state(sendbin, GST_STATE_READY);
@@ -1125,32 +2521,120 @@ bool RtpWorker::startSend(int rate)
 
         actual_localAudioPayloadInfo = localAudioPayloadInfo;
         actual_localVideoPayloadInfo = localVideoPayloadInfo;
+
+        // let later sessions take our packets
+        sendShare.publish(
+            send_share_key(ain, vin, maxbitrate, localAudioParams, localVideoParams, remoteAudioPayloadInfo),
+            localAudioPayloadInfo, localVideoPayloadInfo, videoRtxSendPt, videoencoder);
     }
 
     return true;
 }
 
+// sending into a conference mix.  this is audio only, what the session
+//   hears of the others is what it sends, and it goes in the conference's
+//   own pipeline rather than the shared one.
+bool RtpWorker::startMixSend()
+{
+    if (localAudioParams.isEmpty())
+        return true;
+
+#ifdef RTPWORKER_DEBUG
+    if (!vin.isEmpty())
+        qDebug("conference session, ignoring video input\n");
+#endif
+
+    if (!audioMix)
+        audioMix = new MixerParticipant(ain, mainContext_);
+
+    sendbin  = gst_bin_new("sendbin");
+    audiosrc = audioMix->addSource();
+
+    if (!addAudioChain()) {
+        audioMix->removeSource();
+        audiosrc = nullptr;
+        g_object_unref(G_OBJECT(sendbin));
+        sendbin = nullptr;
+
+        error = RtpSessionContext::ErrorGeneric;
+        return false;
+    }
+
+    audioMix->addBin(sendbin);
+    gst_element_link(audiosrc, sendbin);
+    gst_element_sync_state_with_parent(sendbin);
+    gst_element_sync_state_with_parent(audiosrc);
+
+    // the payloader only has caps once data went through it, and the mix
+    //   runs from our event loop, so we can't wait for them here.  we are
+    //   started once they show up, see mixCaps().
+    mixcaps_mutex.lock();
+    mixCapsTimer = g_timeout_source_new(MIX_CAPS_TIMEOUT);
+    g_source_set_callback(mixCapsTimer, cb_mixCaps, this, nullptr);
+    g_source_attach(mixCapsTimer, mainContext_);
+    mixcaps_mutex.unlock();
+
+    GstPad *pad = gst_element_get_static_pad(audiortppay, "src");
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, cb_mix_caps_probe, this, nullptr);
+    gst_object_unref(pad);
+
+    // don't wait for the next mix to get things flowing
+    audioMix->pushSilence();
+    return true;
+}
+
+// streaming thread
+GstPadProbeReturn RtpWorker::mix_caps_probe(GstPadProbeInfo *info)
+{
+    if (GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) != GST_EVENT_CAPS)
+        return GST_PAD_PROBE_OK;
+
+    QMutexLocker locker(&mixcaps_mutex);
+    if (mixCapsTimer)
+        g_source_set_ready_time(mixCapsTimer, 0);
+    return GST_PAD_PROBE_REMOVE;
+}
+
+gboolean RtpWorker::mixCaps()
+{
+    mixcaps_mutex.lock();
+    g_source_unref(mixCapsTimer);
+    mixCapsTimer = nullptr;
+    mixcaps_mutex.unlock();
+
+    // no caps means we timed out
+    if (!getCaps()) {
+        error = RtpSessionContext::ErrorCodec;
+        if (cb_error)
+            cb_error(app);
+        return FALSE;
+    }
+
+    actual_localAudioPayloadInfo = localAudioPayloadInfo;
+
+    if (cb_started)
+        cb_started(app);
+    return FALSE;
+}
+
 bool RtpWorker::startRecv()
 {
     QString     acodec, vcodec;
     GstElement *audioout = nullptr;
     GstElement *asrc     = nullptr;
 
+    // a conference session receives in the conference pipeline
+    bool mixed = MixerParticipant::isMixerDevice(aout);
+
     // TODO: support more than opus
-    int opus_at    = -1;
-    int samplerate = -1;
-    for (int n = 0; n < remoteAudioPayloadInfo.count(); ++n) {
-        const PPayloadInfo &ri = remoteAudioPayloadInfo[n];
-        if (ri.name.toUpper() == "OPUS") {
-            if (ri.clockrate > samplerate) {
-                opus_at    = n;
-                samplerate = ri.clockrate;
-            }
-        }
-    }
-    if (samplerate != 16000) {
+    int opus_at = opus_payload_at(remoteAudioPayloadInfo);
+
+    // the sender may have been set up before we knew the remote's payload
+    //   type for opus
+    if (opus_at != -1 && audiortppay
+        && payloader_payload_type(audiortppay, "audio-payloader") != remoteAudioPayloadInfo[opus_at].id) {
         cleanup();
-        startSend(samplerate);
+        startSend();
     }
 
     // TODO: support more than theora
@@ -1185,7 +2669,7 @@ bool RtpWorker::startRecv()
             return false;
         }
 
-        if (recv_in_use)
+        if (recv_in_use && !mixed)
             return false;
 
         if (!recvbin)
@@ -1195,9 +2679,11 @@ bool RtpWorker::startRecv()
         audiortpsrc = gst_element_factory_make("appsrc", nullptr);
         audiortpsrc_mutex.unlock();
 
+        // arrival times are needed for the session's jitter statistics
         GstCaps *caps = gst_caps_new_empty();
         gst_caps_append_structure(caps, cs);
-        g_object_set(G_OBJECT(audiortpsrc), "caps", caps, nullptr);
+        g_object_set(G_OBJECT(audiortpsrc), "caps", caps, "is-live", TRUE, "format", GST_FORMAT_TIME, "do-timestamp",
+                     TRUE, nullptr);
         gst_caps_unref(caps);
 
         // FIXME: what if we don't have a name and just id?
@@ -1222,7 +2708,7 @@ bool RtpWorker::startRecv()
             goto fail1;
         }
 
-        if (recv_in_use)
+        if (recv_in_use && !mixed)
             return false;
 
         if (!recvbin)
@@ -1234,13 +2720,16 @@ bool RtpWorker::startRecv()
 
         GstCaps *caps = gst_caps_new_empty();
         gst_caps_append_structure(caps, cs);
-        g_object_set(G_OBJECT(videortpsrc), "caps", caps, nullptr);
+        g_object_set(G_OBJECT(videortpsrc), "caps", caps, "is-live", TRUE, "format", GST_FORMAT_TIME, "do-timestamp",
+                     TRUE, nullptr);
         gst_caps_unref(caps);
 
         // FIXME: what if we don't have a name and just id?
         //   it's okay, for now we only really support theora which
         //   requires the name..
         vcodec = remoteVideoPayloadInfo[at].name;
+
+        videoRtxRecvPt = rtx_payload_type(remoteVideoPayloadInfo, remoteVideoPayloadInfo[at].id);
         if (vcodec == "H263-1998") // FIXME: gross
             vcodec = "h263p";
         else
@@ -1251,14 +2740,19 @@ bool RtpWorker::startRecv()
     if (!recvbin)
         return true;
 
-    recv_in_use = true;
+    if (!mixed)
+        recv_in_use = true;
 
     if (audiortpsrc) {
         GstElement *audiodec = bins_audiodec_create(acodec);
         if (!audiodec)
             goto fail1;
 
-        if (!aout.isEmpty()) {
+        if (mixed) {
+            if (!audioMix)
+                audioMix = new MixerParticipant(aout, mainContext_);
+            audioout = audioMix->createSink();
+        } else if (!aout.isEmpty()) {
 #ifdef RTPWORKER_DEBUG
             qDebug("creating audioout\n");
 #endif
@@ -1301,7 +2795,9 @@ bool RtpWorker::startRecv()
         if (!asrc)
             gst_bin_add(GST_BIN(recvbin), audioout);
 
-        gst_element_link_many(audiortpsrc, audiodec, volumeout, audioconvert, audioresample, nullptr);
+        gst_element_link_many(audiodec, volumeout, audioconvert, audioresample, nullptr);
+        addRecvSession(audiortpsrc, audiodec, false);
+        audioLatency = latency_controller_for(audiodec, &audiojitterbuffer);
         if (!asrc)
             gst_element_link(audioresample, audioout);
 
@@ -1313,9 +2809,34 @@ bool RtpWorker::startRecv()
         if (!videodec)
             goto fail1;
 
+        // scale to the displayed size here, on the streaming thread, and
+        //   before converting to BGRx
+        GstElement *videoscale   = gst_element_factory_make("videoscale", nullptr);
+        GstElement *scalefilter  = gst_element_factory_make("capsfilter", nullptr);
         GstElement *videoconvert = gst_element_factory_make("videoconvert", nullptr);
         GstAppSink *appVideoSink = makeVideoPlayAppSink("netviedeoplay");
 
+        // with rtx, the retransmissions are turned back into the original
+        //   stream before they reach the jitterbuffer.  they arrive through
+        //   the same appsrc, under their own payload type and ssrc.
+        GstElement *rtxreceive = nullptr;
+        if (videoRtxRecvPt != -1) {
+            rtxreceive = gst_element_factory_make("rtprtxreceive", nullptr);
+            if (rtxreceive) {
+                GstStructure *map = rtx_payload_type_map(videoRtxRecvPt, remoteVideoPayloadInfo[theora_at].id);
+                g_object_set(G_OBJECT(rtxreceive), "payload-type-map", map, nullptr);
+                gst_structure_free(map);
+            }
+        }
+
+        {
+            QMutexLocker locker(&output_mutex);
+            GstCaps *    caps = video_max_size_caps(outputMaxSize);
+            g_object_set(G_OBJECT(scalefilter), "caps", caps, nullptr);
+            gst_caps_unref(caps);
+            outputfilter = scalefilter;
+        }
+
         GstAppSinkCallbacks sinkVideoCb;
         sinkVideoCb.new_sample  = cb_show_frame_output;
         sinkVideoCb.eos         = cb_packet_ready_eos_stub;     // TODO
@@ -1324,14 +2845,50 @@ bool RtpWorker::startRecv()
 
         gst_bin_add(GST_BIN(recvbin), videortpsrc);
         gst_bin_add(GST_BIN(recvbin), videodec);
+        gst_bin_add(GST_BIN(recvbin), videoscale);
+        gst_bin_add(GST_BIN(recvbin), scalefilter);
         gst_bin_add(GST_BIN(recvbin), videoconvert);
         gst_bin_add(GST_BIN(recvbin), (GstElement *)appVideoSink);
 
-        gst_element_link_many(videortpsrc, videodec, videoconvert, (GstElement *)appVideoSink, nullptr);
+        gst_element_link_many(videodec, videoscale, scalefilter, videoconvert, (GstElement *)appVideoSink, nullptr);
+        GstElement *session;
+        if (rtxreceive) {
+            gst_bin_add(GST_BIN(recvbin), rtxreceive);
+            gst_element_link(rtxreceive, videodec);
+            session = addRecvSession(videortpsrc, rtxreceive, true);
+        } else
+            session = addRecvSession(videortpsrc, videodec, true);
+        videoLatency = latency_controller_for(videodec, &videojitterbuffer);
+
+        // feedback (nacks, key frame requests) needs the session.  avpf lets
+        //   it go out right away instead of with the next regular report.
+        if (session && videojitterbuffer) {
+            gst_util_set_object_arg(G_OBJECT(session), "rtp-profile", "avpf");
+
+            g_object_set(G_OBJECT(videojitterbuffer), "do-lost", TRUE, nullptr);
+            GstPad *pad = gst_element_get_static_pad(videojitterbuffer, "src");
+            gst_pad_add_probe(pad, GstPadProbeType(GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM),
+                              cb_video_recv_probe, this, nullptr);
+            gst_object_unref(pad);
+        }
+
+        // the jitterbuffer asks for missing packets, the session turns that
+        //   into nacks
+        if (rtxreceive && session && videojitterbuffer)
+            g_object_set(G_OBJECT(videojitterbuffer), "do-retransmission", TRUE, nullptr);
+        else
+            videoRtxRecvPt = -1;
 
         actual_remoteVideoPayloadInfo = remoteVideoPayloadInfo;
     }
 
+    // the conference pipeline is always running
+    if (mixed) {
+        audioMix->addBin(recvbin);
+        gst_element_sync_state_with_parent(recvbin);
+        return true;
+    }
+
     // gst_element_set_locked_state(recvbin, TRUE);
     gst_bin_add(GST_BIN(rpipeline), recvbin);
 
@@ -1397,43 +2954,248 @@ fail1:
     delete pd_audiosink;
     pd_audiosink = nullptr;
 
-    recv_in_use = false;
+    if (!mixed)
+        recv_in_use = false;
 
     return false;
 }
 
-bool RtpWorker::addAudioChain() { return addAudioChain(16000); }
 
-bool RtpWorker::addAudioChain(int rate)
+static QString payload_parameter(const PPayloadInfo &pi, const QString &name)
+{
+    for (const PPayloadInfo::Parameter &param : pi.parameters) {
+        if (param.name == name)
+            return param.value;
+    }
+    return QString();
+}
+
+// opus fmtp (rfc 7587).  these state what we'd like to receive, which we
+//   take to be what we were configured to send.
+static void opus_add_payload_parameters(const PAudioParams &params, PPayloadInfo *pi)
+{
+    QList<QPair<QString, QString>> list;
+    if (params.fec)
+        list << qMakePair(QString("useinbandfec"), QString("1"));
+    if (params.dtx)
+        list << qMakePair(QString("usedtx"), QString("1"));
+    if (params.bitrate > 0)
+        list << qMakePair(QString("maxaveragebitrate"), QString::number(params.bitrate * 1000));
+
+    for (const auto &i : list) {
+        PPayloadInfo::Parameter param;
+        param.name  = i.first;
+        param.value = i.second;
+        pi->parameters += param;
+    }
+    if (params.ptime > 0)
+        pi->ptime = params.ptime;
+}
+
+// the nominal bitrate from the theora identification header in the
+//   stream headers, or 0 if it isn't there or wasn't set by the encoder
+static int theora_nominal_bitrate(GstStructure *cs)
+{
+    const GValue *headers = gst_structure_get_value(cs, "streamheader");
+    if (!headers || !GST_VALUE_HOLDS_ARRAY(headers) || gst_value_array_get_size(headers) < 1)
+        return 0;
+
+    const GValue *first = gst_value_array_get_value(headers, 0);
+    if (!GST_VALUE_HOLDS_BUFFER(first))
+        return 0;
+
+    GstMapInfo info;
+    GstBuffer * buf = gst_value_get_buffer(first);
+    if (!gst_buffer_map(buf, &info, GST_MAP_READ))
+        return 0;
+
+    // 0x80 "theora", version, frame and picture geometry, frame rate,
+    //   aspect ratio and colour space come first, then 24 bits of bitrate
+    int           bitrate = 0;
+    const guint8 *p     = info.data;
+    if (info.size >= 42 && p[0] == 0x80 && memcmp(p + 1, "theora", 6) == 0)
+        bitrate = (p[37] << 16) | (p[38] << 8) | p[39];
+
+    gst_buffer_unmap(buf, &info);
+    return bitrate;
+}
+
+// a stream is sent as it is only if that doesn't break a limit: the
+//   remote's opus options, our own opus bitrate and the session's maximum.
+//   opus headers don't state a bitrate, so any limit on audio means
+//   transcoding.  theora passes if it's no bigger than what we would have
+//   encoded, and its nominal bitrate fits what's left after the audio.
+bool RtpWorker::fileStreamPassesThrough(GstStructure *cs)
+{
+    if (get_file_transcode())
+        return false;
+
+    QString mime = gst_structure_get_name(cs);
+    if (mime == "audio/x-opus") {
+        int channels = 0, family = 0;
+        gst_structure_get_int(cs, "channels", &channels);
+        gst_structure_get_int(cs, "channel-mapping-family", &family);
+        if (family != 0 || channels < 1 || channels > 2)
+            return false;
+
+        int remote_at = opus_payload_at(remoteAudioPayloadInfo);
+        if (channels == 2 && remote_at != -1 && payload_parameter(remoteAudioPayloadInfo[remote_at], "stereo") == "0")
+            return false;
+        if (remote_at != -1 && payload_parameter(remoteAudioPayloadInfo[remote_at], "maxaveragebitrate").toInt() > 0)
+            return false;
+        for (const PAudioParams &p : localAudioParams) {
+            if (p.codec == "opus" && p.bitrate > 0)
+                return false;
+        }
+        return !localAudioParams.isEmpty();
+    } else if (mime == "video/x-theora") {
+        int   width = 0, height = 0, fps;
+        QSize size;
+        gst_structure_get_int(cs, "width", &width);
+        gst_structure_get_int(cs, "height", &height);
+        video_params_for_send(localVideoParams, maxbitrate, &size, &fps);
+        if (localVideoParams.isEmpty() || width <= 0 || height <= 0 || width > size.width()
+            || height > size.height())
+            return false;
+
+        // same budget as addVideoChain(), an unstated bitrate could be anything
+        int videokbps = maxbitrate;
+        if (!localAudioParams.isEmpty())
+            videokbps -= 45;
+        int bitrate = theora_nominal_bitrate(cs);
+        return bitrate > 0 && bitrate <= videokbps * 1000;
+    }
+
+    return false;
+}
+
+// a file stream straight into the payloader, paced by the sink.  no volume
+//   control or rate adaptation, that would need decoding.
+bool RtpWorker::addPassthroughChain(GstPad *pad, bool video)
 {
-    // TODO: support other codecs.  for now, we only support opus 16khz
-    QString codec    = "opus";
-    int     size     = 16;
-    int     channels = 1;
-    // QString codec = localAudioParams[0].codec;
-    // int rate = localAudioParams[0].sampleRate;
-    // int size = localAudioParams[0].sampleSize;
-    // int channels = localAudioParams[0].channels;
+    int pt = -1;
+    if (video) {
+        for (const PPayloadInfo &ri : remoteVideoPayloadInfo) {
+            if (ri.name.toUpper() == "THEORA" && ri.clockrate == 90000) {
+                pt = ri.id;
+                break;
+            }
+        }
+    } else {
+        int remote_at = opus_payload_at(remoteAudioPayloadInfo);
+        if (remote_at != -1)
+            pt = remoteAudioPayloadInfo[remote_at].id;
+    }
+
+    GstElement *queue = gst_element_factory_make("queue", nullptr);
+    GstElement *pay   = gst_element_factory_make(video ? "rtptheorapay" : "rtpopuspay",
+                                               video ? "video-payloader" : "audio-payloader");
+    if (!queue || !pay) {
+        if (queue)
+            g_object_unref(G_OBJECT(queue));
+        if (pay)
+            g_object_unref(G_OBJECT(pay));
+        return false;
+    }
+    if (pt != -1)
+        g_object_set(G_OBJECT(pay), "pt", pt, nullptr);
+
+    GstElement *rtpsink = gst_element_factory_make("appsink", nullptr);
+
+    GstAppSinkCallbacks sinkCb = {};
+    sinkCb.new_sample          = video ? cb_packet_ready_rtp_video : cb_packet_ready_rtp_audio;
+    sinkCb.eos                 = cb_packet_ready_eos_rtp;
+    sinkCb.new_preroll         = cb_packet_ready_preroll_stub;
+    gst_app_sink_set_callbacks(reinterpret_cast<GstAppSink *>(rtpsink), &sinkCb, this, nullptr);
+    if (fileLoop)
+        fileLoop->watchPass(rtpsink);
+
+    gst_bin_add(GST_BIN(sendbin), queue);
+    gst_bin_add(GST_BIN(sendbin), pay);
+    gst_bin_add(GST_BIN(sendbin), rtpsink);
+
+    GstPad *sinkpad = gst_element_get_static_pad(queue, "sink");
+    bool    linked  = GST_PAD_LINK_SUCCESSFUL(gst_pad_link(pad, sinkpad));
+    gst_object_unref(sinkpad);
+    if (!linked || !gst_element_link(queue, pay)) {
+        gst_bin_remove(GST_BIN(sendbin), queue);
+        gst_bin_remove(GST_BIN(sendbin), pay);
+        gst_bin_remove(GST_BIN(sendbin), rtpsink);
+        return false;
+    }
+    addSendSession(pay, rtpsink, video);
+
 #ifdef RTPWORKER_DEBUG
-    qDebug("codec=%s\n", qPrintable(codec));
+    qDebug("sending %s from the file without transcoding\n", video ? "video" : "audio");
 #endif
 
-    // see if we need to match a pt id
-    int pt = -1;
-    for (int n = 0; n < remoteAudioPayloadInfo.count(); ++n) {
-        const PPayloadInfo &ri = remoteAudioPayloadInfo[n];
-        if (ri.name.toUpper() == "OPUS" && ri.clockrate == rate) {
-            pt = ri.id;
+    // like the decoders, get the new elements working
+    gst_element_set_state(queue, GST_STATE_PAUSED);
+    gst_element_set_state(pay, GST_STATE_PAUSED);
+    gst_element_set_state(rtpsink, GST_STATE_PAUSED);
+
+    if (video)
+        videortppay = pay;
+    else
+        audiortppay = pay;
+    return true;
+}
+
+bool RtpWorker::addAudioChain()
+{
+    // TODO: support other codecs.  for now, we only support opus, in the
+    //   first opus mode asked for
+    QString      codec = "opus";
+    PAudioParams params;
+    for (const PAudioParams &p : localAudioParams) {
+        if (p.codec == codec) {
+            params = p;
             break;
         }
     }
+    params.codec      = codec;
+    params.sampleSize = 16;
+    if (params.sampleRate <= 0)
+        params.sampleRate = DEFAULT_OPUS_RATE;
+    // we always capture and send mono, whatever was asked for, so the
+    //   payloader never announces stereo we don't deliver
+    params.channels = 1;
+#ifdef RTPWORKER_DEBUG
+    qDebug("codec=%s rate=%d channels=%d\n", qPrintable(codec), params.sampleRate, params.channels);
+#endif
+
+    // see if we need to match a pt id.  opus is always clocked at 48khz, so
+    //   the rate doesn't tell the entries apart, the name does.
+    int pt        = -1;
+    int remote_at = opus_payload_at(remoteAudioPayloadInfo);
+    if (remote_at != -1)
+        pt = remoteAudioPayloadInfo[remote_at].id;
 
     // NOTE: we don't bother with a maxbitrate constraint on audio yet
 
-    GstElement *audioenc = bins_audioenc_create(codec, pt, rate, size, channels);
+    // honor what the remote asked for in its fmtp
+    if (remote_at != -1) {
+        const PPayloadInfo &ri = remoteAudioPayloadInfo[remote_at];
+        if (payload_parameter(ri, "useinbandfec") == "1")
+            params.fec = true;
+        if (payload_parameter(ri, "usedtx") == "1")
+            params.dtx = true;
+        int maxbps = payload_parameter(ri, "maxaveragebitrate").toInt();
+        if (maxbps > 0 && (params.bitrate == 0 || params.bitrate * 1000 > maxbps))
+            params.bitrate = qMax(maxbps / 1000, 6);
+        if (params.ptime == 0 && ri.ptime > 0)
+            params.ptime = ri.ptime;
+    }
+    audioEncParams = params;
+
+    GstElement *audioenc = bins_audioenc_create(params, pt);
     if (!audioenc)
         return false;
 
+    audioencoder = gst_bin_get_by_name(GST_BIN(audioenc), "opus-encoder");
+    if (audioencoder)
+        gst_object_unref(audioencoder); // the bin keeps it alive
+
     {
         QMutexLocker locker(&volumein_mutex);
         volumein   = gst_element_factory_make("volume", nullptr);
@@ -1449,9 +3211,11 @@ bool RtpWorker::addAudioChain(int rate)
 
     GstAppSinkCallbacks sinkCb;
     sinkCb.new_sample  = cb_packet_ready_rtp_audio;
-    sinkCb.eos         = cb_packet_ready_eos_stub;     // TODO
+    sinkCb.eos         = cb_packet_ready_eos_rtp;
     sinkCb.new_preroll = cb_packet_ready_preroll_stub; // TODO
     gst_app_sink_set_callbacks(appRtpSink, &sinkCb, this, nullptr);
+    if (fileLoop)
+        fileLoop->watchPass(audiortpsink);
 
     GstElement *queue = nullptr;
     if (fileDemux)
@@ -1464,7 +3228,8 @@ bool RtpWorker::addAudioChain(int rate)
     gst_bin_add(GST_BIN(sendbin), audioenc);
     gst_bin_add(GST_BIN(sendbin), audiortpsink);
 
-    gst_element_link_many(volumein, audioenc, audiortpsink, nullptr);
+    gst_element_link(volumein, audioenc);
+    addSendSession(audioenc, audiortpsink, false);
 
     audiortppay = audioenc;
 
@@ -1493,13 +3258,11 @@ bool RtpWorker::addVideoChain()
 {
     // TODO: support other codecs.  for now, we only support theora
     QString codec = "theora";
-    QSize   size  = QSize(640, 480);
-    int     fps   = 30;
-    // QString codec = localVideoParams[0].codec;
-    // QSize size = localVideoParams[0].size;
-    // int fps = localVideoParams[0].fps;
+    QSize   size;
+    int     fps;
+    video_params_for_send(localVideoParams, maxbitrate, &size, &fps);
 #ifdef RTPWORKER_DEBUG
-    qDebug("codec=%s\n", qPrintable(codec));
+    qDebug("codec=%s size=%dx%d fps=%d\n", qPrintable(codec), size.width(), size.height(), fps);
 #endif
 
     // see if we need to match a pt id
@@ -1518,7 +3281,7 @@ bool RtpWorker::addVideoChain()
         videokbps -= 45;
 
 #ifdef VIDEO_PREP
-    GstElement *videoprep = bins_videoprep_create(size, fps, fileDemux ? false : true);
+    GstElement *videoprep = bins_videoprep_create(codec, size, fps, fileDemux ? false : true);
     if (!videoprep)
         return false;
 #endif
@@ -1532,10 +3295,29 @@ bool RtpWorker::addVideoChain()
 
     GstElement *videotee = gst_element_factory_make("tee", nullptr);
 
+    // preview branch: drop frames and shrink before converting to BGRx, so a
+    //   thumbnail costs as much as a thumbnail
     GstElement *playqueue        = gst_element_factory_make("queue", nullptr);
+    GstElement *playrate         = gst_element_factory_make("videorate", nullptr);
+    GstElement *playscale        = gst_element_factory_make("videoscale", nullptr);
+    GstElement *playfilter       = gst_element_factory_make("capsfilter", nullptr);
     GstElement *videoconvertplay = gst_element_factory_make("videoconvert", nullptr);
     GstAppSink *appVideoSink     = makeVideoPlayAppSink("sourcevideoplay");
 
+    // a late preview frame is worthless, don't let them pile up
+    g_object_set(G_OBJECT(playqueue), "leaky", 2, "max-size-buffers", 2, "max-size-bytes", 0, "max-size-time",
+                 G_GUINT64_CONSTANT(0), nullptr);
+    g_object_set(G_OBJECT(playrate), "drop-only", TRUE, nullptr);
+
+    preview_mutex.lock();
+    g_object_set(G_OBJECT(playrate), "max-rate", previewMaxFps > 0 ? previewMaxFps : G_MAXINT, nullptr);
+    GstCaps *playcaps = video_max_size_caps(previewMaxSize);
+    g_object_set(G_OBJECT(playfilter), "caps", playcaps, nullptr);
+    gst_caps_unref(playcaps);
+    previewrate   = playrate;
+    previewfilter = playfilter;
+    preview_mutex.unlock();
+
     GstAppSinkCallbacks sinkPreviewCb;
     sinkPreviewCb.new_sample  = cb_show_frame_preview;
     sinkPreviewCb.eos         = cb_packet_ready_eos_stub;     // TODO
@@ -1550,9 +3332,11 @@ bool RtpWorker::addVideoChain()
 
     GstAppSinkCallbacks sinkCb;
     sinkCb.new_sample  = cb_packet_ready_rtp_video;
-    sinkCb.eos         = cb_packet_ready_eos_stub;     // TODO
+    sinkCb.eos         = cb_packet_ready_eos_rtp;
     sinkCb.new_preroll = cb_packet_ready_preroll_stub; // TODO
     gst_app_sink_set_callbacks(appRtpSink, &sinkCb, this, nullptr);
+    if (fileLoop)
+        fileLoop->watchPass(videortpsink);
 
     GstElement *queue = nullptr;
     if (fileDemux)
@@ -1565,6 +3349,9 @@ bool RtpWorker::addVideoChain()
 #endif
     gst_bin_add(GST_BIN(sendbin), videotee);
     gst_bin_add(GST_BIN(sendbin), playqueue);
+    gst_bin_add(GST_BIN(sendbin), playrate);
+    gst_bin_add(GST_BIN(sendbin), playscale);
+    gst_bin_add(GST_BIN(sendbin), playfilter);
     gst_bin_add(GST_BIN(sendbin), videoconvertplay);
     gst_bin_add(GST_BIN(sendbin), (GstElement *)appVideoSink);
     gst_bin_add(GST_BIN(sendbin), rtpqueue);
@@ -1573,11 +3360,35 @@ bool RtpWorker::addVideoChain()
 #ifdef VIDEO_PREP
     gst_element_link(videoprep, videotee);
 #endif
-    gst_element_link_many(videotee, playqueue, videoconvertplay, (GstElement *)appVideoSink, nullptr);
-    gst_element_link_many(videotee, rtpqueue, videoenc, videortpsink, nullptr); // FIXME!
+    gst_element_link_many(videotee, playqueue, playrate, playscale, playfilter, videoconvertplay,
+                          (GstElement *)appVideoSink, nullptr);
+    gst_element_link_many(videotee, rtpqueue, videoenc, nullptr);
+    addSendSession(videoenc, videortpsink, true);
 
     videortppay = videoenc;
 
+    videoencoder = gst_bin_get_by_name(GST_BIN(videoenc), "video-encoder");
+    if (videoencoder) {
+        gst_object_unref(videoencoder); // the bin keeps it alive
+
+        GstPad *pad = gst_element_get_static_pad(videoencoder, "src");
+        gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_EVENT_UPSTREAM, cb_video_keyframe_request, this, nullptr);
+        gst_object_unref(pad);
+    }
+
+    // the encoder bitrate follows the network within the configured
+    //   maximum, and below that the frame rate, if the prep lets us drop
+    //   frames without changing the caps.  the size stays, since that means
+    //   new theora headers the remote only gets through signalling.
+    if (!fileDemux && codec == "theora") {
+#ifdef VIDEO_PREP
+        videopreprate = gst_bin_get_by_name(GST_BIN(videoprep), "video-rate");
+        if (videopreprate)
+            gst_object_unref(videopreprate); // the bin keeps it alive
+#endif
+        videoBitrate = new BitrateController(videokbps, videopreprate ? fps : -1);
+    }
+
     if (fileDemux) {
 #ifdef VIDEO_PREP
         gst_element_link(queue, videoprep);
@@ -1591,6 +3402,9 @@ bool RtpWorker::addVideoChain()
 #endif
         gst_element_set_state(videotee, GST_STATE_PAUSED);
         gst_element_set_state(playqueue, GST_STATE_PAUSED);
+        gst_element_set_state(playrate, GST_STATE_PAUSED);
+        gst_element_set_state(playscale, GST_STATE_PAUSED);
+        gst_element_set_state(playfilter, GST_STATE_PAUSED);
         gst_element_set_state(videoconvertplay, GST_STATE_PAUSED);
         gst_element_set_state((GstElement *)appVideoSink, GST_STATE_PAUSED);
         gst_element_set_state(rtpqueue, GST_STATE_PAUSED);
@@ -1644,13 +3458,16 @@ bool RtpWorker::getCaps()
 
         gst_caps_unref(caps);
 
+        opus_add_payload_parameters(audioEncParams, &pi);
+
         PPayloadInfo opusnb;
-        opusnb.id        = 97;
-        opusnb.name      = "OPUS";
-        opusnb.clockrate = 8000;
-        opusnb.channels  = 1;
-        opusnb.ptime     = pi.ptime;
-        opusnb.maxptime  = pi.maxptime;
+        opusnb.id         = 97;
+        opusnb.name       = "OPUS";
+        opusnb.clockrate  = 8000;
+        opusnb.channels   = 1;
+        opusnb.ptime      = pi.ptime;
+        opusnb.maxptime   = pi.maxptime;
+        opusnb.parameters = pi.parameters;
 
         QList<PPayloadInfo> ppil;
         ppil << pi;
@@ -1690,6 +3507,23 @@ bool RtpWorker::getCaps()
         gst_caps_unref(caps);
 
         localVideoPayloadInfo = QList<PPayloadInfo>() << pi;
+
+        if (videoRtxSendPt != -1) {
+            PPayloadInfo rtx;
+            rtx.id        = videoRtxSendPt;
+            rtx.name      = "rtx";
+            rtx.clockrate = pi.clockrate;
+
+            PPayloadInfo::Parameter apt;
+            apt.name  = "apt";
+            apt.value = QString::number(pi.id);
+            PPayloadInfo::Parameter rtxTime;
+            rtxTime.name  = "rtx-time";
+            rtxTime.value = QString::number(RTX_CACHE_TIME);
+            rtx.parameters << apt << rtxTime;
+
+            localVideoPayloadInfo << rtx;
+        }
         canTransmitVideo      = true;
     }
 
@@ -21,16 +21,27 @@
 #ifndef RTPWORKER_H
 #define RTPWORKER_H
 
+#include "callrecorder.h"
+#include "filecache.h"
 #include "psimediaprovider.h"
+#include "sendshare.h"
 #include <QByteArray>
+#include <QElapsedTimer>
 #include <QImage>
 #include <QMutex>
+#include <QSharedPointer>
 #include <QString>
 #include <gst/app/gstappsink.h>
 #include <gst/gst.h>
 
 namespace PsiMedia {
 
+class BitrateController;
+class DeviceSwap;
+class FileLoop;
+class FileReplay;
+class LatencyController;
+class MixerParticipant;
 class PipelineDeviceContext;
 
 class Stats;
@@ -38,6 +49,22 @@ class Stats;
 // Note: do not destruct this class during one of its callbacks
 class RtpWorker {
 public:
+    // network conditions learned from rtcp, -1 when not known (yet)
+    class NetworkStats {
+    public:
+        int    roundTripMs   = -1; // from the remote's receiver reports
+        double sendLoss      = -1; // fraction of what we send the remote lost (0-1)
+        int    sendJitterMs  = -1; // jitter the remote sees on what we send
+        int    recvJitterMs  = -1; // jitter we see on what we receive
+        int    recvLost      = -1; // packets lost on what we receive, cumulative
+        int    recvLatencyMs = -1; // current jitterbuffer latency
+        double recvLateRate  = -1; // fraction of received packets that arrived too late to play
+
+        // highest sequence number the remote reported, tells apart a
+        //   new receiver report from the same one read again
+        qint64 sendReportSeq = -1;
+    };
+
     // this class exists in case we want to add metadata to the image,
     //   such as a timestamp
     class Frame {
@@ -81,13 +108,27 @@ public:
     void pauseVideo();
     void stop(); // can be called at any time after calling start
 
-    // the rtp input functions are safe to call from any thread
+    // the rtp input functions are safe to call from any thread.  packets
+    //   with portOffset 1 are rtcp.
     void rtpAudioIn(const PRtpPacket &packet);
     void rtpVideoIn(const PRtpPacket &packet);
 
+    // safe to call from any thread
+    NetworkStats audioNetworkStats();
+    NetworkStats videoNetworkStats();
+
     void setOutputVolume(int level);
     void setInputVolume(int level);
 
+    // preview frames are scaled down to fit maxSize and limited to maxFps
+    //   inside the pipeline.  invalid size / 0 fps means no limit, and
+    //   negative fps means the default.
+    void setPreviewLimits(const QSize &maxSize, int maxFps);
+
+    // output frames are scaled to fit maxSize (the size of the displaying
+    //   widget).  invalid size means no scaling.
+    void setOutputMaxSize(const QSize &maxSize);
+
     void recordStart();
     void recordStop();
 
@@ -115,29 +156,52 @@ public:
 private:
     GMainContext *mainContext_ = nullptr;
     GSource *     timer        = nullptr;
+    GSource *     statsTimer   = nullptr;
 
     PipelineDeviceContext *pd_audiosrc = nullptr, *pd_videosrc = nullptr, *pd_audiosink = nullptr;
     GstElement *           sendbin = nullptr, *recvbin = nullptr;
 
-    GstElement *fileDemux   = nullptr;
-    GstElement *audiosrc    = nullptr;
-    GstElement *videosrc    = nullptr;
-    GstElement *audiortpsrc = nullptr;
-    GstElement *videortpsrc = nullptr;
-    GstElement *audiortppay = nullptr;
-    GstElement *videortppay = nullptr;
-    GstElement *volumein    = nullptr;
-    GstElement *volumeout   = nullptr;
-    bool        rtpaudioout = false;
-    bool        rtpvideoout = false;
+    GstElement *fileDemux        = nullptr;
+    GstElement *audiosrc         = nullptr;
+    GstElement *videosrc         = nullptr;
+    GstElement *audiortpsrc      = nullptr;
+    GstElement *videortpsrc      = nullptr;
+    GstElement *audiortppay      = nullptr;
+    GstElement *videortppay      = nullptr;
+    GstElement *audiosendsession = nullptr; // one rtpsession per media and direction
+    GstElement *videosendsession = nullptr;
+    GstElement *audiorecvsession = nullptr;
+    GstElement *videorecvsession = nullptr;
+    GstElement *audiosendrtcpsrc = nullptr; // remote rtcp goes into both sessions
+    GstElement *videosendrtcpsrc = nullptr;
+    GstElement *audiorecvrtcpsrc = nullptr;
+    GstElement *videorecvrtcpsrc = nullptr;
+    quint32     audioSsrc;              // what both sessions of a media call themselves,
+    quint32     videoSsrc;              //   so our reports match the stream we send
+    GstElement *volumein         = nullptr;
+    GstElement *volumeout        = nullptr;
+    GstElement *previewrate      = nullptr;
+    GstElement *previewfilter    = nullptr;
+    GstElement *outputfilter     = nullptr;
+    bool        rtpaudioout      = false;
+    bool        rtpvideoout      = false;
+    QSize       previewMaxSize;
+    QSize       outputMaxSize;
+    int         previewMaxFps = 0;
     QMutex      audiortpsrc_mutex;
     QMutex      videortpsrc_mutex;
+    QMutex      audiortcpsrc_mutex;
+    QMutex      videortcpsrc_mutex;
     QMutex      volumein_mutex;
     QMutex      volumeout_mutex;
+    QMutex      preview_mutex;
+    QMutex      output_mutex;
     QMutex      rtpaudioout_mutex;
     QMutex      rtpvideoout_mutex;
 
     // GSource *recordTimer;
+    CallRecorder *recorder = nullptr;
+    QMutex        record_mutex;
 
     QList<PPayloadInfo> actual_localAudioPayloadInfo;
     QList<PPayloadInfo> actual_localVideoPayloadInfo;
@@ -147,6 +211,71 @@ private:
     Stats *audioStats = nullptr;
     Stats *videoStats = nullptr;
 
+    // video rate adaptation, only while sending video from a device
+    BitrateController *videoBitrate   = nullptr;
+    qint64             videoReportSeq = -1;
+    GstElement *       videoencoder   = nullptr;
+    GstElement *       videopreprate  = nullptr; // frames are dropped here at the bitrate floor
+
+    // opus settings in use, the fec follows the loss the remote reports
+    PAudioParams audioEncParams;
+    GstElement * audioencoder     = nullptr;
+    int          audioLossPercent = -1;
+
+    // receive latency adaptation
+    LatencyController *audioLatency      = nullptr;
+    LatencyController *videoLatency      = nullptr;
+    GstElement *       audiojitterbuffer = nullptr;
+    GstElement *       videojitterbuffer = nullptr;
+
+    // rfc 4588 retransmission payload types for video, -1 if not in use
+    int videoRtxSendPt = -1;
+    int videoRtxRecvPt = -1;
+
+    // key frame requests.  each side is only touched from its streaming
+    //   thread while running.
+    qint64        videoRecvSsrc = -1;
+    QElapsedTimer keyframeRequested; // we asked the remote
+    QElapsedTimer keyframeForced;    // the remote asked us
+
+    NetworkStats audioNetStats;
+    NetworkStats videoNetStats;
+    QMutex       netstats_mutex;
+
+    // set when taking part in a conference mix
+    MixerParticipant *audioMix = nullptr;
+
+    // a conference sender is started once its payloader has caps.  the
+    //   timer fires early when they arrive, or gives up after a while.
+    //   the streaming thread touches it, so it is guarded.
+    GSource *mixCapsTimer = nullptr;
+    QMutex   mixcaps_mutex;
+
+    // encode-once fan-out, when our packets are shared with other sessions
+    //   or we take those of another.  the streams we take are sent
+    //   rewritten, guarded by the rtp*out mutexes.
+    SendShareMember sendShare;
+    SharedStream    shareAudio;
+    SharedStream    shareVideo;
+    QByteArray      shareCname; // for the sender reports of the rewritten streams
+
+    // file input: looping it, and for the file cache, recording what we
+    //   send from it or replaying what a session sent from it before.  the
+    //   recording side is guarded.
+    QSharedPointer<FileCacheEntry>       fileRecording;
+    QElapsedTimer                        fileRecordClock;
+    int                                  fileStreams       = 0; // sent from the file
+    int                                  fileStreamsEnded  = 0;
+    GSource *                            fileFinishedTimer = nullptr;
+    FileLoop *                           fileLoop          = nullptr;
+    bool                                 fileRecordDone    = false;
+    GSource *                            fileStoreTimer    = nullptr;
+    QMutex                               filerecord_mutex;
+    FileReplay *                         fileReplay = nullptr;
+
+    // devices switched while the session runs, at most one per type
+    QList<DeviceSwap *> deviceSwaps;
+
     void cleanup();
 
     static gboolean      cb_doStart(gpointer data);
@@ -160,9 +289,29 @@ private:
     static GstFlowReturn cb_show_frame_output(GstAppSink *appsink, gpointer data);
     static GstFlowReturn cb_packet_ready_rtp_audio(GstAppSink *appsink, gpointer data);
     static GstFlowReturn cb_packet_ready_rtp_video(GstAppSink *appsink, gpointer data);
+    static GstFlowReturn cb_packet_ready_rtcp_audio_send(GstAppSink *appsink, gpointer data);
+    static GstFlowReturn cb_packet_ready_rtcp_audio_recv(GstAppSink *appsink, gpointer data);
+    static GstFlowReturn cb_packet_ready_rtcp_video_send(GstAppSink *appsink, gpointer data);
+    static GstFlowReturn cb_packet_ready_rtcp_video_recv(GstAppSink *appsink, gpointer data);
     static GstFlowReturn cb_packet_ready_preroll_stub(GstAppSink *appsink, gpointer data);
     static void          cb_packet_ready_eos_stub(GstAppSink *appsink, gpointer data);
+    static void          cb_packet_ready_eos_rtp(GstAppSink *appsink, gpointer data);
     static gboolean      cb_fileReady(gpointer data);
+    static gboolean      cb_fileFinished(gpointer data);
+    static void          cb_fileFirstPassSent(void *data);
+    static gboolean      cb_fileStore(gpointer data);
+    static void          cb_fileReplayLooped(void *data);
+    static void          cb_fileReplayFinished(void *data);
+    static void          cb_sharedPacket(const PRtpPacket &packet, bool video, void *data);
+    static void          cb_shareLost(void *data);
+    static void          cb_recorder_data(const QByteArray &buf, void *data);
+    static gboolean      cb_doStats(gpointer data);
+    static void          cb_deviceSwapped(DeviceSwap *swap, void *data);
+    static gboolean      cb_mixCaps(gpointer data);
+
+    static GstPadProbeReturn cb_video_recv_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+    static GstPadProbeReturn cb_video_keyframe_request(GstPad *pad, GstPadProbeInfo *info, gpointer data);
+    static GstPadProbeReturn cb_mix_caps_probe(GstPad *pad, GstPadProbeInfo *info, gpointer data);
 
     gboolean      doStart();
     gboolean      doUpdate();
@@ -175,18 +324,46 @@ private:
     GstFlowReturn show_frame_output(GstAppSink *appsink);
     GstFlowReturn packet_ready_rtp_audio(GstAppSink *appsink);
     GstFlowReturn packet_ready_rtp_video(GstAppSink *appsink);
+    GstFlowReturn packet_ready_rtcp(GstAppSink *appsink, bool video, bool sending);
+    void          packet_ready_eos_rtp();
     gboolean      fileReady();
+    gboolean      fileFinished();
+    void          fileFirstPassSent();
+    gboolean      fileStore();
+    void          storeFileRecording();
+    void          fileReplayLooped();
+    void          fileReplayFinished();
+    void          shareLost();
+    gboolean      doStats();
+    void          deviceSwapped(DeviceSwap *swap);
+    gboolean      mixCaps();
+
+    GstPadProbeReturn video_recv_probe(GstPad *pad, GstPadProbeInfo *info);
+    GstPadProbeReturn video_keyframe_request(GstPadProbeInfo *info);
+    GstPadProbeReturn mix_caps_probe(GstPadProbeInfo *info);
 
     bool        setupSendRecv();
+    void        switchDevices();
+    bool        startDeviceSwap(PDevice::Type type, const QString &id);
+    void        finishDeviceSwap(DeviceSwap *swap);
     bool        startSend();
-    bool        startSend(int rate);
+    bool        startMixSend();
+    bool        joinSendShare();
+    void        sharedPacketOut(const PRtpPacket &packet, bool video);
+    void        recordFilePacket(const PRtpPacket &packet, bool video);
+    bool        startFileReplay(const QSharedPointer<const FileCacheEntry> &entry);
     bool        startRecv();
+    bool        fileStreamPassesThrough(GstStructure *cs);
+    bool        addPassthroughChain(GstPad *pad, bool video);
     bool        addAudioChain();
-    bool        addAudioChain(int rate);
     bool        addVideoChain();
     bool        getCaps();
     bool        updateTheoraConfig();
     GstAppSink *makeVideoPlayAppSink(const gchar *name);
+    GstElement *addSendSession(GstElement *pay, GstElement *rtpsink, bool video);
+    GstElement *addRecvSession(GstElement *rtpsrc, GstElement *dec, bool video);
+    GstElement *makeRtxSend(GstElement *pay);
+    void        startStatsTimer();
 };
 
 }
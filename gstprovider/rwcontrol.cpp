@@ -126,6 +126,8 @@ static void applyDevicesToWorker(RtpWorker *worker, const RwControlConfigDevices
     worker->loopFile = devices.loopFile;
     worker->setOutputVolume(devices.audioOutVolume);
     worker->setInputVolume(devices.audioInVolume);
+    worker->setPreviewLimits(devices.videoPreviewMaxSize, devices.videoPreviewMaxFps);
+    worker->setOutputMaxSize(devices.videoOutputMaxSize);
 }
 
 static void applyCodecsToWorker(RtpWorker *worker, const RwControlConfigCodecs &codecs)
@@ -218,6 +220,10 @@ void RwControlLocal::rtpAudioIn(const PRtpPacket &packet) { remote_->rtpAudioIn(
 
 void RwControlLocal::rtpVideoIn(const PRtpPacket &packet) { remote_->rtpVideoIn(packet); }
 
+RtpWorker::NetworkStats RwControlLocal::audioNetworkStats() { return remote_->worker->audioNetworkStats(); }
+
+RtpWorker::NetworkStats RwControlLocal::videoNetworkStats() { return remote_->worker->videoNetworkStats(); }
+
 // note: this is executed in the remote thread
 gboolean RwControlLocal::cb_doCreateRemote(gpointer data)
 {
@@ -94,9 +94,13 @@ public:
     bool       useVideoOut;
     int        audioOutVolume;
     int        audioInVolume;
+    QSize      videoPreviewMaxSize; // invalid = no limit
+    int        videoPreviewMaxFps;  // 0 = no limit, -1 = default
+    QSize      videoOutputMaxSize;  // invalid = no limit
 
     RwControlConfigDevices() :
-        loopFile(false), useVideoPreview(false), useVideoOut(false), audioOutVolume(-1), audioInVolume(-1)
+        loopFile(false), useVideoPreview(false), useVideoOut(false), audioOutVolume(-1), audioInVolume(-1),
+        videoPreviewMaxFps(-1)
     {
     }
 };
@@ -272,6 +276,10 @@ public:
     void rtpAudioIn(const PRtpPacket &packet);
     void rtpVideoIn(const PRtpPacket &packet);
 
+    // can be called from any thread
+    RtpWorker::NetworkStats audioNetworkStats();
+    RtpWorker::NetworkStats videoNetworkStats();
+
     // can come from any thread.
     // note that it is only safe to assign callbacks prior to starting.
     // note if the stream is stopped while recording is active, then
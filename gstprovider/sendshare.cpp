@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+
+#include "sendshare.h"
+
+#include <QMutex>
+#include <gst/video/video.h>
+
+// streams we send rewritten have no rtp session of their own, so we send
+//   sender reports for them this often (ms)
+#define SHARE_REPORT_INTERVAL 5000
+
+namespace PsiMedia {
+
+// clock rate of a stream sent with the given payload types, for rewriting
+static int payload_clock_rate(const QList<PPayloadInfo> &info, int fallback)
+{
+    return !info.isEmpty() && info.first().clockrate > 0 ? info.first().clockrate : fallback;
+}
+
+void SharedStream::reset(const QList<PPayloadInfo> &from, const QList<PPayloadInfo> &to, int clockrate,
+                         quint32 ssrc)
+{
+    rewriter = RtpRewriter(payload_clock_rate(from, clockrate));
+    rewriter.setSsrc(ssrc);
+    ptMap = relay_payload_map(from, to);
+    reported.invalidate();
+}
+
+void SharedStream::resync() { rewriter.resync(); }
+
+bool SharedStream::rewrite(QByteArray *packet, const QByteArray &cname, QByteArray *report)
+{
+    if (!rewriter.rewrite(packet, ptMap))
+        return false;
+
+    if (!reported.isValid() || reported.elapsed() >= SHARE_REPORT_INTERVAL) {
+        *report = rewriter.senderReport(cname);
+        reported.start();
+    }
+    return true;
+}
+
+//----------------------------------------------------------------------------
+// SendShareMember
+//----------------------------------------------------------------------------
+class SendShare {
+public:
+    QString                  key;
+    SendShareMember *        owner;
+    QList<SendShareMember *> subscribers;
+    QList<PPayloadInfo>      audioPayloadInfo;
+    QList<PPayloadInfo>      videoPayloadInfo;
+    int                      videoRtxPt;
+    GstElement *             videoEncoder; // referenced, may be null
+};
+
+static QMutex             send_shares_mutex;
+static QList<SendShare *> send_shares;
+
+SendShareMember::SendShareMember(GMainContext *mainContext) : mainContext_(mainContext) { }
+
+SendShareMember::~SendShareMember() { leave(); }
+
+bool SendShareMember::join(const QString &key, QList<PPayloadInfo> *audioPayloadInfo,
+                           QList<PPayloadInfo> *videoPayloadInfo)
+{
+    send_shares_mutex.lock();
+    for (SendShare *s : send_shares) {
+        if (s->key == key) {
+            s->subscribers += this;
+            share = s;
+            break;
+        }
+    }
+    if (share) {
+        *audioPayloadInfo = share->audioPayloadInfo;
+        *videoPayloadInfo = share->videoPayloadInfo;
+    }
+    send_shares_mutex.unlock();
+
+    if (!share)
+        return false;
+
+    requestKeyFrame();
+    return true;
+}
+
+void SendShareMember::publish(const QString &key, const QList<PPayloadInfo> &audioPayloadInfo,
+                              const QList<PPayloadInfo> &videoPayloadInfo, int videoRtxPt, GstElement *videoEncoder)
+{
+    SendShare *s        = new SendShare;
+    s->key              = key;
+    s->owner            = this;
+    s->audioPayloadInfo = audioPayloadInfo;
+    s->videoPayloadInfo = videoPayloadInfo;
+    s->videoRtxPt       = videoRtxPt;
+    s->videoEncoder     = videoEncoder ? GST_ELEMENT(gst_object_ref(videoEncoder)) : nullptr;
+
+    QMutexLocker locker(&send_shares_mutex);
+    send_shares += s;
+    share = s;
+}
+
+void SendShareMember::setKey(const QString &key)
+{
+    QMutexLocker locker(&send_shares_mutex);
+    if (share && share->owner == this)
+        share->key = key;
+}
+
+void SendShareMember::leave()
+{
+    QMutexLocker locker(&send_shares_mutex);
+    if (lostTimer) {
+        g_source_destroy(lostTimer);
+        g_source_unref(lostTimer);
+        lostTimer = nullptr;
+    }
+
+    if (!share)
+        return;
+
+    if (share->owner == this) {
+        for (SendShareMember *m : share->subscribers) {
+            m->share     = nullptr;
+            m->lostTimer = g_timeout_source_new(0);
+            g_source_set_callback(m->lostTimer, cb_lost_timeout, m, nullptr);
+            g_source_attach(m->lostTimer, m->mainContext_);
+        }
+        send_shares.removeAll(share);
+        if (share->videoEncoder)
+            gst_object_unref(share->videoEncoder);
+        delete share;
+    } else
+        share->subscribers.removeAll(this);
+
+    share = nullptr;
+}
+
+bool SendShareMember::isSubscriber() const
+{
+    QMutexLocker locker(&send_shares_mutex);
+    return share && share->owner != this;
+}
+
+void SendShareMember::fanOut(const PRtpPacket &packet, bool video)
+{
+    QMutexLocker locker(&send_shares_mutex);
+    if (!share || share->owner != this || share->subscribers.isEmpty())
+        return;
+
+    // retransmissions only answer our own remote's nacks
+    if (video && share->videoRtxPt != -1 && packet.rawValue.size() >= 2
+        && (quint8(packet.rawValue[1]) & 0x7f) == share->videoRtxPt)
+        return;
+
+    for (SendShareMember *m : share->subscribers) {
+        if (m->cb_packet)
+            m->cb_packet(packet, video, m->app);
+    }
+}
+
+// nacks can't be answered this way, the owner's retransmissions have other
+//   sequence numbers than what our remote saw
+void SendShareMember::requestKeyFrame()
+{
+    GstElement *encoder = nullptr;
+    send_shares_mutex.lock();
+    if (share && share->owner != this && share->videoEncoder)
+        encoder = GST_ELEMENT(gst_object_ref(share->videoEncoder));
+    send_shares_mutex.unlock();
+    if (!encoder)
+        return;
+
+    GstPad *pad = gst_element_get_static_pad(encoder, "src");
+    gst_pad_send_event(pad, gst_video_event_new_upstream_force_key_unit(GST_CLOCK_TIME_NONE, TRUE, 0));
+    gst_object_unref(pad);
+    gst_object_unref(encoder);
+}
+
+gboolean SendShareMember::cb_lost_timeout(gpointer data)
+{
+    return static_cast<SendShareMember *>(data)->lost_timeout();
+}
+
+gboolean SendShareMember::lost_timeout()
+{
+    send_shares_mutex.lock();
+    g_source_unref(lostTimer);
+    lostTimer = nullptr;
+    send_shares_mutex.unlock();
+
+    if (cb_lost)
+        cb_lost(app);
+    return FALSE;
+}
+
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2026  Psi IM Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301  USA
+ *
+ */
+
+
+#ifndef PSI_SENDSHARE_H
+#define PSI_SENDSHARE_H
+
+#include "psimediaprovider.h"
+#include "rtprelay.h"
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <gst/gst.h>
+
+namespace PsiMedia {
+
+class SendShare;
+
+// packets encoded elsewhere, by a shared encoder or long ago for the file
+//   cache, sent on as a stream of our own: with our ssrc, the payload types
+//   our remote expects, and sender reports, since the stream has no rtp
+//   session to send them.  not thread-safe.
+class SharedStream {
+public:
+    // from: the payload types the packets come with, to: those our remote
+    //   expects.  clockrate is used if from doesn't have one.
+    void reset(const QList<PPayloadInfo> &from, const QList<PPayloadInfo> &to, int clockrate, quint32 ssrc);
+
+    // the input starts over, see RtpRewriter::resync()
+    void resync();
+
+    // rewrite packet in place, returns false if it should be dropped.  a
+    //   sender report with the given cname goes into report when one is
+    //   due, otherwise it is left alone.
+    bool rewrite(QByteArray *packet, const QByteArray &cname, QByteArray *report);
+
+private:
+    RtpRewriter     rewriter;
+    QHash<int, int> ptMap;
+    QElapsedTimer   reported;
+};
+
+// a session's part in encode-once fan-out: the output of a sending session
+//   passed on to other sessions that would have encoded exactly the same.
+//   the owner publishes its output under a key describing it, and later
+//   sessions with the same key subscribe to it.  safe to call from any
+//   thread.
+class SendShareMember {
+public:
+    void *app = nullptr; // for callbacks
+
+    // a packet of the owner, for a subscriber.  called from the owner's
+    //   streaming threads.
+    void (*cb_packet)(const PRtpPacket &packet, bool video, void *app) = nullptr;
+
+    // the owner went away, the subscriber has to send by itself now.
+    //   called from a timer on mainContext.
+    void (*cb_lost)(void *app) = nullptr;
+
+    SendShareMember(GMainContext *mainContext);
+    ~SendShareMember();
+
+    // subscribe to what is published under key, if anything.  gives the
+    //   payload types the owner sends with, and asks it for a key frame,
+    //   as our remote can't decode anything before one.
+    bool join(const QString &key, QList<PPayloadInfo> *audioPayloadInfo, QList<PPayloadInfo> *videoPayloadInfo);
+
+    // let later sessions take our packets.  retransmissions (videoRtxPt,
+    //   -1 if none) aren't passed on, and the key frame requests of the
+    //   subscribers go to videoEncoder, if any.
+    void publish(const QString &key, const QList<PPayloadInfo> &audioPayloadInfo,
+                 const QList<PPayloadInfo> &videoPayloadInfo, int videoRtxPt, GstElement *videoEncoder);
+
+    // what we publish changed, when our devices are switched
+    void setKey(const QString &key);
+
+    // when the owner leaves, its subscribers go on by themselves, see
+    //   cb_lost
+    void leave();
+
+    bool isSubscriber() const;
+
+    // as the owner, pass one of our packets on to the subscribers
+    void fanOut(const PRtpPacket &packet, bool video);
+
+    // as a subscriber, ask the encoder we take the video of for a key
+    //   frame.  it takes care of not turning a burst of requests into a
+    //   burst of key frames.
+    void requestKeyFrame();
+
+private:
+    GMainContext *mainContext_;
+    SendShare *   share     = nullptr; // guarded by the registry
+    GSource *     lostTimer = nullptr;
+
+    static gboolean cb_lost_timeout(gpointer data);
+
+    gboolean lost_timeout();
+};
+
+}
+
+#endif
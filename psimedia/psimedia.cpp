@@ -31,6 +31,12 @@ static AudioParams importAudioParams(const PAudioParams &pp)
     out.setSampleRate(pp.sampleRate);
     out.setSampleSize(pp.sampleSize);
     out.setChannels(pp.channels);
+    out.setPtime(pp.ptime);
+    out.setBitrate(pp.bitrate);
+    out.setComplexity(pp.complexity);
+    out.setPacketLoss(pp.packetLoss);
+    out.setFec(pp.fec);
+    out.setDtx(pp.dtx);
     return out;
 }
 
@@ -41,6 +47,12 @@ static PAudioParams exportAudioParams(const AudioParams &p)
     out.sampleRate = p.sampleRate();
     out.sampleSize = p.sampleSize();
     out.channels   = p.channels();
+    out.ptime      = p.ptime();
+    out.bitrate    = p.bitrate();
+    out.complexity = p.complexity();
+    out.packetLoss = p.packetLoss();
+    out.fec        = p.fec();
+    out.dtx        = p.dtx();
     return out;
 }
 
@@ -62,6 +74,19 @@ static PVideoParams exportVideoParams(const VideoParams &p)
     return out;
 }
 
+static NetworkStats importNetworkStats(const PNetworkStats &pp)
+{
+    NetworkStats out;
+    out.setRoundTripTime(pp.roundTripMs);
+    out.setSendLoss(pp.sendLoss);
+    out.setSendJitter(pp.sendJitterMs);
+    out.setReceiveJitter(pp.recvJitterMs);
+    out.setReceiveLost(pp.recvLost);
+    out.setReceiveLatency(pp.recvLatencyMs);
+    out.setReceiveLateRate(pp.recvLateRate);
+    return out;
+}
+
 static PayloadInfo importPayloadInfo(const PPayloadInfo &pp)
 {
     PayloadInfo out;
@@ -297,8 +322,18 @@ public:
     int     sampleRate;
     int     sampleSize;
     int     channels;
-
-    Private() : sampleRate(0), sampleSize(0), channels(0) {}
+    int     ptime;
+    int     bitrate;
+    int     complexity;
+    int     packetLoss;
+    bool    fec;
+    bool    dtx;
+
+    Private() :
+        sampleRate(0), sampleSize(0), channels(0), ptime(0), bitrate(0), complexity(0), packetLoss(0), fec(false),
+        dtx(false)
+    {
+    }
 };
 
 AudioParams::AudioParams() : d(new Private) {}
@@ -321,6 +356,18 @@ int AudioParams::sampleSize() const { return d->sampleSize; }
 
 int AudioParams::channels() const { return d->channels; }
 
+int AudioParams::ptime() const { return d->ptime; }
+
+int AudioParams::bitrate() const { return d->bitrate; }
+
+int AudioParams::complexity() const { return d->complexity; }
+
+int AudioParams::packetLoss() const { return d->packetLoss; }
+
+bool AudioParams::fec() const { return d->fec; }
+
+bool AudioParams::dtx() const { return d->dtx; }
+
 QString AudioParams::toString() const
 {
     return QString("%1 %2 %3 %4")
@@ -335,10 +382,24 @@ void AudioParams::setSampleSize(int n) { d->sampleSize = n; }
 
 void AudioParams::setChannels(int n) { d->channels = n; }
 
+void AudioParams::setPtime(int n) { d->ptime = n; }
+
+void AudioParams::setBitrate(int n) { d->bitrate = n; }
+
+void AudioParams::setComplexity(int n) { d->complexity = n; }
+
+void AudioParams::setPacketLoss(int n) { d->packetLoss = n; }
+
+void AudioParams::setFec(bool b) { d->fec = b; }
+
+void AudioParams::setDtx(bool b) { d->dtx = b; }
+
 bool AudioParams::operator==(const AudioParams &other) const
 {
     if (d->codec == other.d->codec && d->sampleRate == other.d->sampleRate && d->sampleSize == other.d->sampleSize
-        && d->channels == other.d->channels) {
+        && d->channels == other.d->channels && d->ptime == other.d->ptime && d->bitrate == other.d->bitrate
+        && d->complexity == other.d->complexity && d->packetLoss == other.d->packetLoss && d->fec == other.d->fec
+        && d->dtx == other.d->dtx) {
         return true;
     } else
         return false;
@@ -395,6 +456,66 @@ QString VideoParams::toString() const
              QString::number(d->fps));
 }
 
+//----------------------------------------------------------------------------
+// NetworkStats
+//----------------------------------------------------------------------------
+class NetworkStats::Private {
+public:
+    int    roundTripTime;
+    double sendLoss;
+    int    sendJitter;
+    int    receiveJitter;
+    int    receiveLost;
+    int    receiveLatency;
+    double receiveLateRate;
+
+    Private() :
+        roundTripTime(-1), sendLoss(-1), sendJitter(-1), receiveJitter(-1), receiveLost(-1), receiveLatency(-1),
+        receiveLateRate(-1)
+    {
+    }
+};
+
+NetworkStats::NetworkStats() : d(new Private) {}
+
+NetworkStats::NetworkStats(const NetworkStats &other) : d(new Private(*other.d)) {}
+
+NetworkStats::~NetworkStats() { delete d; }
+
+NetworkStats &NetworkStats::operator=(const NetworkStats &other)
+{
+    *d = *other.d;
+    return *this;
+}
+
+int NetworkStats::roundTripTime() const { return d->roundTripTime; }
+
+double NetworkStats::sendLoss() const { return d->sendLoss; }
+
+int NetworkStats::sendJitter() const { return d->sendJitter; }
+
+int NetworkStats::receiveJitter() const { return d->receiveJitter; }
+
+int NetworkStats::receiveLost() const { return d->receiveLost; }
+
+int NetworkStats::receiveLatency() const { return d->receiveLatency; }
+
+double NetworkStats::receiveLateRate() const { return d->receiveLateRate; }
+
+void NetworkStats::setRoundTripTime(int n) { d->roundTripTime = n; }
+
+void NetworkStats::setSendLoss(double x) { d->sendLoss = x; }
+
+void NetworkStats::setSendJitter(int n) { d->sendJitter = n; }
+
+void NetworkStats::setReceiveJitter(int n) { d->receiveJitter = n; }
+
+void NetworkStats::setReceiveLost(int n) { d->receiveLost = n; }
+
+void NetworkStats::setReceiveLatency(int n) { d->receiveLatency = n; }
+
+void NetworkStats::setReceiveLateRate(double x) { d->receiveLateRate = x; }
+
 //----------------------------------------------------------------------------
 // Features
 //----------------------------------------------------------------------------
@@ -659,6 +780,13 @@ void RtpSession::setFileDataInput(const QByteArray &fileData) { d->c->setFileDat
 
 void RtpSession::setFileLoopEnabled(bool enabled) { d->c->setFileLoopEnabled(enabled); }
 
+void RtpSession::setAudioMixer(const QString &name)
+{
+    QString id = QLatin1String(PSIMEDIA_MIXER_DEVICE_PREFIX) + name;
+    d->c->setAudioInputDevice(id);
+    d->c->setAudioOutputDevice(id);
+}
+
 #ifdef QT_GUI_LIB
 void RtpSession::setVideoPreviewWidget(VideoWidget *widget)
 {
@@ -718,6 +846,13 @@ void RtpSession::pauseVideo() { d->c->pauseVideo(); }
 
 void RtpSession::stop() { d->c->stop(); }
 
+void RtpSession::addRelayTarget(RtpSession *target, bool audio, bool video)
+{
+    d->c->addRelayTarget(target->d->c, audio, video);
+}
+
+void RtpSession::removeRelayTarget(RtpSession *target) { d->c->removeRelayTarget(target->d->c); }
+
 QList<PayloadInfo> RtpSession::localAudioPayloadInfo() const
 {
     QList<PayloadInfo> out;
@@ -780,6 +915,10 @@ void RtpSession::setInputVolume(int level) { d->c->setInputVolume(level); }
 
 RtpSession::Error RtpSession::errorCode() const { return static_cast<RtpSession::Error>(d->c->errorCode()); }
 
+NetworkStats RtpSession::audioNetworkStats() const { return importNetworkStats(d->c->audioNetworkStats()); }
+
+NetworkStats RtpSession::videoNetworkStats() const { return importNetworkStats(d->c->videoNetworkStats()); }
+
 RtpChannel *RtpSession::audioRtpChannel() { return &d->audioRtpChannel; }
 
 RtpChannel *RtpSession::videoRtpChannel() { return &d->videoRtpChannel; }
@@ -112,10 +112,25 @@ public:
     int     channels() const;
     QString toString() const;
 
+    // encoder tuning, where the codec supports it (currently opus).  0 or
+    //   false leaves the codec default.
+    int  ptime() const;      // milliseconds of audio per packet
+    int  bitrate() const;    // kbps
+    int  complexity() const; // 1-10, higher costs more cpu
+    int  packetLoss() const; // expected loss in percent, sizes the fec data
+    bool fec() const;        // in-band forward error correction
+    bool dtx() const;        // discontinuous transmission, no packets during silence
+
     void setCodec(const QString &s);
     void setSampleRate(int n);
     void setSampleSize(int n);
     void setChannels(int n);
+    void setPtime(int n);
+    void setBitrate(int n);
+    void setComplexity(int n);
+    void setPacketLoss(int n);
+    void setFec(bool b);
+    void setDtx(bool b);
 
     bool operator==(const AudioParams &other) const;
 
@@ -151,6 +166,36 @@ private:
     Private *d;
 };
 
+// network conditions of one media type, learned from rtcp.  values are -1
+//   when not known (yet).
+class NetworkStats {
+public:
+    NetworkStats();
+    NetworkStats(const NetworkStats &other);
+    ~NetworkStats();
+    NetworkStats &operator=(const NetworkStats &other);
+
+    int    roundTripTime() const;   // milliseconds
+    double sendLoss() const;        // fraction of what we send that the peer lost (0-1)
+    int    sendJitter() const;      // milliseconds, as the peer sees what we send
+    int    receiveJitter() const;   // milliseconds, of what we receive
+    int    receiveLost() const;     // packets lost of what we receive, so far
+    int    receiveLatency() const;  // milliseconds the jitterbuffer holds packets back
+    double receiveLateRate() const; // fraction of what we receive that came too late to play
+
+    void setRoundTripTime(int n);
+    void setSendLoss(double x);
+    void setSendJitter(int n);
+    void setReceiveJitter(int n);
+    void setReceiveLost(int n);
+    void setReceiveLatency(int n);
+    void setReceiveLateRate(double x);
+
+private:
+    class Private;
+    Private *d;
+};
+
 class Features : public QObject {
     Q_OBJECT
 
@@ -286,8 +331,20 @@ public:
     void setVideoOutputWidget(VideoWidget *widget);
 #endif
 
+    // input devices are used by one session at a time.  a session started
+    //   on devices another session is already sending from, with the same
+    //   local prefs and maximum bitrate, takes that session's encoded
+    //   packets instead of failing.  such a session is send-only: leave its
+    //   remote prefs unset (the peer learns the payload types from our
+    //   local payloadinfo), as asking to receive makes start() and
+    //   updatePreferences() fail with ErrorGeneric.  key frame requests
+    //   from its peer reach the shared encoder, retransmission requests
+    //   are not answered.
     void setAudioInputDevice(const QString &deviceId);
     void setVideoInputDevice(const QString &deviceId);
+    // large files are mapped into memory while playing, so they must not
+    //   be truncated or rewritten in place meanwhile (replacing them is
+    //   fine).  a truncated mapping crashes the process.
     void setFileInput(const QString &fileName);
     void setFileDataInput(const QByteArray &fileData);
     void setFileLoopEnabled(bool enabled);
@@ -295,9 +352,22 @@ public:
     void setVideoPreviewWidget(VideoWidget *widget);
 #endif
 
+    // join a conference mix instead of using the sound devices.  sessions
+    //   with the same mixer name hear each other: each one is sent the mix
+    //   of everyone but itself.  the full mix is only computed once, so
+    //   this works for large conferences.  conference sessions send audio
+    //   only, and unlike device sessions any number of them can run at once.
+    void setAudioMixer(const QString &name);
+
     // pass a QIODevice to record to.  if a device is set before starting
     //   the session, then recording will wait until it starts.
-    // records in ogg theora+vorbis format
+    // records in ogg format, the opus and theora streams of both sides as
+    //   they were sent (or, with PSI_RECORD_TRANSCODE set, the audio of both
+    //   sides mixed into one opus stream).  a QFile is written from a
+    //   thread of its own, so slow storage doesn't hold anything up.  other
+    //   devices (sockets and the like) are written in the thread they
+    //   belong to, which needs a running event loop.  either way, leave the
+    //   device alone until stoppedRecording.
     void setRecordingQIODevice(QIODevice *dev);
 
     // stop recording operation.  wait for stoppedRecording signal before
@@ -403,6 +473,29 @@ public:
     void pauseVideo();
     void stop();
 
+    // forward-only relaying (for a conference server).  packets written to
+    //   this session's channels are passed on, without being decoded, to
+    //   the channels of target as if target had produced them.  ssrc,
+    //   sequence numbers and timestamps are rewritten, so that the peer of
+    //   target sees one continuous stream per media type even as relayed
+    //   sources come and go.  payload types are matched up by codec using
+    //   the remote preferences of both sessions, and follow them when
+    //   either side changes them.
+    //
+    // each media type of a target is fed by one session at a time: adding
+    //   a target makes this session its source for the given types, taking
+    //   over from the previous one, whose packets are dropped from then on.
+    //   on a switch the new source's sender is asked for a key frame.
+    //
+    // rtcp is not relayed.  the target's peer gets sender reports for the
+    //   stream it sees, and when it asks for a key frame (pli or fir), the
+    //   request is passed on to the sender of the current source.  other
+    //   rtcp stays with the session it is for.
+    //
+    // a session used only for relaying does not need to be started.
+    void addRelayTarget(RtpSession *target, bool audio = true, bool video = true);
+    void removeRelayTarget(RtpSession *target);
+
     // in a correctly negotiated session, there will be an equal amount of
     //   local/remote values for each media type (during negotiation there
     //   may be a mismatch).  however, the payloadinfo for each won't
@@ -441,6 +534,10 @@ public:
 
     Error errorCode() const;
 
+    // updated as rtcp comes in, while the session runs
+    NetworkStats audioNetworkStats() const;
+    NetworkStats videoNetworkStats() const;
+
     RtpChannel *audioRtpChannel();
     RtpChannel *videoRtpChannel();
 
@@ -42,6 +42,10 @@ class QPainter;
 #define HINT_PUBLIC_SLOTS public
 #define HINT_METHOD(x)
 
+// audio device ids starting with this name a conference mix, see
+//   RtpSession::setAudioMixer()
+#define PSIMEDIA_MIXER_DEVICE_PREFIX "psimedia-mix:"
+
 namespace PsiMedia {
 
 class Provider;
@@ -82,7 +86,37 @@ public:
     int     sampleSize;
     int     channels;
 
-    inline PAudioParams() : sampleRate(0), sampleSize(0), channels(0) {}
+    // encoder tuning, 0/false means the codec default
+    int  ptime;      // milliseconds of audio per packet
+    int  bitrate;    // kbps
+    int  complexity; // 1-10
+    int  packetLoss; // expected loss in percent, for fec
+    bool fec;
+    bool dtx;
+
+    inline PAudioParams() :
+        sampleRate(0), sampleSize(0), channels(0), ptime(0), bitrate(0), complexity(0), packetLoss(0), fec(false),
+        dtx(false)
+    {
+    }
+};
+
+// -1 when not known (yet)
+class PNetworkStats {
+public:
+    int    roundTripMs;
+    double sendLoss; // 0-1
+    int    sendJitterMs;
+    int    recvJitterMs;
+    int    recvLost;
+    int    recvLatencyMs;
+    double recvLateRate; // 0-1
+
+    inline PNetworkStats() :
+        roundTripMs(-1), sendLoss(-1), sendJitterMs(-1), recvJitterMs(-1), recvLost(-1), recvLatencyMs(-1),
+        recvLateRate(-1)
+    {
+    }
 };
 
 class PVideoParams {
@@ -237,9 +271,17 @@ public:
 
     virtual Error errorCode() const = 0;
 
+    // safe to call at any time
+    virtual PNetworkStats audioNetworkStats() const = 0;
+    virtual PNetworkStats videoNetworkStats() const = 0;
+
     virtual RtpChannelContext *audioRtpChannel() = 0;
     virtual RtpChannelContext *videoRtpChannel() = 0;
 
+    // target belongs to the same provider
+    virtual void addRelayTarget(RtpSessionContext *target, bool audio, bool video) = 0;
+    virtual void removeRelayTarget(RtpSessionContext *target)                      = 0;
+
     HINT_SIGNALS : HINT_METHOD(started()) HINT_METHOD(preferencesUpdated())
                        HINT_METHOD(audioOutputIntensityChanged(int intensity))
                            HINT_METHOD(audioInputIntensityChanged(int intensity)) HINT_METHOD(stoppedRecording())
@@ -249,10 +291,10 @@ public:
 
 }
 
-Q_DECLARE_INTERFACE(PsiMedia::Plugin, "org.psi-im.psimedia.Plugin/1.4")
-Q_DECLARE_INTERFACE(PsiMedia::Provider, "org.psi-im.psimedia.Provider/1.4")
-Q_DECLARE_INTERFACE(PsiMedia::FeaturesContext, "org.psi-im.psimedia.FeaturesContext/1.4")
-Q_DECLARE_INTERFACE(PsiMedia::RtpChannelContext, "org.psi-im.psimedia.RtpChannelContext/1.4")
-Q_DECLARE_INTERFACE(PsiMedia::RtpSessionContext, "org.psi-im.psimedia.RtpSessionContext/1.4")
+Q_DECLARE_INTERFACE(PsiMedia::Plugin, "org.psi-im.psimedia.Plugin/1.5")
+Q_DECLARE_INTERFACE(PsiMedia::Provider, "org.psi-im.psimedia.Provider/1.5")
+Q_DECLARE_INTERFACE(PsiMedia::FeaturesContext, "org.psi-im.psimedia.FeaturesContext/1.5")
+Q_DECLARE_INTERFACE(PsiMedia::RtpChannelContext, "org.psi-im.psimedia.RtpChannelContext/1.5")
+Q_DECLARE_INTERFACE(PsiMedia::RtpSessionContext, "org.psi-im.psimedia.RtpSessionContext/1.5")
 
 #endif